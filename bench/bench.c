@@ -0,0 +1,524 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** bench.c (generation & output benchmark)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ntsc.h"
+#include "output.h"
+#include "palette.h"
+#include "parallel.h"
+#include "timer.h"
+
+/* each phase is repeated until it has run for at least this */
+/* long (and at least this many times); the fastest run is   */
+/* reported, since it is the least disturbed by other work   */
+#define BENCH_MIN_SECONDS 0.25
+#define BENCH_MIN_REPS    3
+#define BENCH_MAX_REPS    100000
+
+enum
+{
+  BENCH_FORMAT_CSV = 0,
+  BENCH_FORMAT_JSON
+};
+
+enum
+{
+  BENCH_PHASE_VOLTAGE_TABLES = 0,
+  BENCH_PHASE_PHASOR_TABLES,
+  BENCH_PHASE_GENERATE,
+  BENCH_PHASE_WRITE_GPL,
+  BENCH_PHASE_WRITE_TGA,
+  BENCH_NUM_PHASES
+};
+
+static char* S_phase_names[BENCH_NUM_PHASES] =
+  { "generate_voltage_tables",
+    "generate_phasor_tables",
+    "generate_palette",
+    "write_gpl_file",
+    "write_tga_file"
+  };
+
+/* scaled up synthetic sizes (luma steps x hues) */
+static int S_synthetic_sizes[][2] =
+  { {64,    48},
+    {256,   192},
+    {1024,  768},
+    {2048,  1536}
+  };
+
+#define BENCH_NUM_SYNTHETIC_SIZES 4
+
+/* sampled signal sizes (512 & 4096 colors) */
+static int S_signal_sizes[][2] =
+  { {32,    15},
+    {256,   15}
+  };
+
+#define BENCH_NUM_SIGNAL_SIZES 2
+
+/* composite filter frame sizes (width x height) */
+static int S_ntsc_sizes[][2] =
+  { {256,   240},
+    {640,   480}
+  };
+
+#define BENCH_NUM_NTSC_SIZES 2
+
+typedef struct bench_result
+{
+  int     reps;
+  double  seconds;
+  long    num_bytes;
+} bench_result;
+
+static int  S_format;
+static int  S_num_rows;
+static int  S_fixed_point;
+
+static char S_gpl_filename[256];
+static char S_tga_filename[256];
+
+/*******************************************************************************
+** bench_file_size()
+*******************************************************************************/
+static long bench_file_size(char* filename)
+{
+  FILE* fp;
+  long  size;
+
+  fp = fopen(filename, "rb");
+
+  if (fp == NULL)
+    return 0;
+
+  if (fseek(fp, 0, SEEK_END))
+  {
+    fclose(fp);
+    return 0;
+  }
+
+  size = ftell(fp);
+
+  fclose(fp);
+
+  return size;
+}
+
+/*******************************************************************************
+** bench_run_phase()
+*******************************************************************************/
+static short int bench_run_phase(palette_context* pc, int phase)
+{
+  if (phase == BENCH_PHASE_VOLTAGE_TABLES)
+    return generate_voltage_tables(pc);
+  else if (phase == BENCH_PHASE_PHASOR_TABLES)
+    return generate_phasor_tables(pc);
+  else if (phase == BENCH_PHASE_GENERATE)
+    return generate_palette_colors(pc);
+  else if (phase == BENCH_PHASE_WRITE_GPL)
+    return write_gpl_file(pc, S_gpl_filename);
+  else if (phase == BENCH_PHASE_WRITE_TGA)
+    return write_tga_file(pc, S_tga_filename);
+
+  return 1;
+}
+
+/*******************************************************************************
+** bench_phase()
+*******************************************************************************/
+static short int bench_phase(palette_context* pc, int phase,
+                             bench_result* result)
+{
+  double start;
+  double elapsed;
+  double total;
+
+  /* warm up */
+  if (bench_run_phase(pc, phase))
+    return 1;
+
+  result->reps = 0;
+  result->seconds = 0.0;
+
+  total = 0.0;
+
+  while ( (result->reps < BENCH_MAX_REPS) &&
+          ((total < BENCH_MIN_SECONDS) || (result->reps < BENCH_MIN_REPS)))
+  {
+    start = timer_seconds();
+
+    if (bench_run_phase(pc, phase))
+      return 1;
+
+    elapsed = timer_seconds() - start;
+
+    if ((result->reps == 0) || (elapsed < result->seconds))
+      result->seconds = elapsed;
+
+    total += elapsed;
+    result->reps += 1;
+  }
+
+  /* bytes written (output phases only) */
+  if (phase == BENCH_PHASE_WRITE_GPL)
+    result->num_bytes = bench_file_size(S_gpl_filename);
+  else if (phase == BENCH_PHASE_WRITE_TGA)
+    result->num_bytes = bench_file_size(S_tga_filename);
+  else
+    result->num_bytes = 0;
+
+  return 0;
+}
+
+/*******************************************************************************
+** bench_print_result()
+*******************************************************************************/
+static void bench_print_result( palette_context* pc, int phase,
+                                bench_result* result)
+{
+  double ns_per_color;
+  double mb_per_second;
+
+  ns_per_color = 0.0;
+  mb_per_second = 0.0;
+
+  if (pc->num_colors > 0)
+    ns_per_color = (result->seconds * 1.0e9) / pc->num_colors;
+
+  if (result->seconds > 0.0)
+    mb_per_second = (result->num_bytes / 1.0e6) / result->seconds;
+
+  if (S_format == BENCH_FORMAT_JSON)
+  {
+    printf("%s\n  {\"palette\": \"%s\", \"colors\": %d, \"phase\": \"%s\", ",
+           (S_num_rows > 0) ? "," : "", pc->name, pc->num_colors,
+           S_phase_names[phase]);
+    printf("\"reps\": %d, \"seconds\": %.9f, \"ns_per_color\": %.3f, ",
+           result->reps, result->seconds, ns_per_color);
+    printf("\"bytes\": %ld, \"mb_per_s\": %.3f}",
+           result->num_bytes, mb_per_second);
+  }
+  else
+  {
+    printf("%s,%d,%s,%d,%.9f,%.3f,%ld,%.3f\n",
+           pc->name, pc->num_colors, S_phase_names[phase],
+           result->reps, result->seconds, ns_per_color,
+           result->num_bytes, mb_per_second);
+  }
+
+  S_num_rows += 1;
+}
+
+/*******************************************************************************
+** bench_palette()
+*******************************************************************************/
+static short int bench_palette(palette_context* pc)
+{
+  bench_result result;
+
+  int phase;
+
+  pc->fixed_point = S_fixed_point;
+
+  /* generate once, so that every phase has its inputs */
+  if (palette_generate(pc))
+    return 1;
+
+  for (phase = 0; phase < BENCH_NUM_PHASES; phase++)
+  {
+    if (bench_phase(pc, phase, &result))
+    {
+      fprintf(stderr, "Benchmark of %s failed for %s.\n",
+              S_phase_names[phase], pc->name);
+      return 1;
+    }
+
+    bench_print_result(pc, phase, &result);
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** bench_ntsc()
+*******************************************************************************/
+static short int bench_ntsc(int width, int height)
+{
+  bench_result result;
+
+  color*  input;
+  color*  output;
+
+  char    name[PALETTE_NAME_LENGTH];
+
+  double  start;
+  double  elapsed;
+  double  total;
+
+  int     num_pixels;
+  int     x;
+  int     y;
+
+  num_pixels = width * height;
+
+  input = malloc(sizeof(color) * num_pixels);
+  output = malloc(sizeof(color) * num_pixels);
+
+  if ((input == NULL) || (output == NULL))
+  {
+    free(input);
+    free(output);
+    return 1;
+  }
+
+  /* color bars over a ramp, with fine detail for the fringes */
+  for (y = 0; y < height; y++)
+  {
+    for (x = 0; x < width; x++)
+    {
+      input[y * width + x].r = ((x / 32) & 1) ? 255 : (x & 0xFF);
+      input[y * width + x].g = ((x / 64) & 1) ? 255 : (y & 0xFF);
+      input[y * width + x].b = ((x + y) & 1) ? 255 : 0;
+    }
+  }
+
+  /* warm up */
+  if (ntsc_filter_rows(input, output, width, height, 0, 1, 0))
+  {
+    free(input);
+    free(output);
+    return 1;
+  }
+
+  result.reps = 0;
+  result.seconds = 0.0;
+  result.num_bytes = 0;
+
+  total = 0.0;
+
+  /* each rep is the next frame, so the dots move as they would */
+  while ( (result.reps < BENCH_MAX_REPS) &&
+          ((total < BENCH_MIN_SECONDS) || (result.reps < BENCH_MIN_REPS)))
+  {
+    start = timer_seconds();
+
+    if (ntsc_filter_rows( input, output, width, height, 0, 1,
+                          result.reps + 1))
+    {
+      free(input);
+      free(output);
+      return 1;
+    }
+
+    elapsed = timer_seconds() - start;
+
+    if ((result.reps == 0) || (elapsed < result.seconds))
+      result.seconds = elapsed;
+
+    total += elapsed;
+    result.reps += 1;
+  }
+
+  free(input);
+  free(output);
+
+  /* the pixels take the place of the colors */
+  sprintf(name, "ntsc_%dx%d", width, height);
+
+  if (S_format == BENCH_FORMAT_JSON)
+  {
+    printf("%s\n  {\"palette\": \"%s\", \"colors\": %d, ",
+           (S_num_rows > 0) ? "," : "", name, num_pixels);
+    printf("\"phase\": \"ntsc_filter_rows\", \"reps\": %d, ",
+           result.reps);
+    printf("\"seconds\": %.9f, \"ns_per_color\": %.3f, ",
+           result.seconds, (result.seconds * 1.0e9) / num_pixels);
+    printf("\"bytes\": 0, \"mb_per_s\": 0.000}");
+  }
+  else
+  {
+    printf("%s,%d,ntsc_filter_rows,%d,%.9f,%.3f,0,0.000\n",
+           name, num_pixels, result.reps, result.seconds,
+           (result.seconds * 1.0e9) / num_pixels);
+  }
+
+  S_num_rows += 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** main()
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+  int   i;
+  int   k;
+
+  int   source;
+  int   max_size;
+
+  char* output_dir;
+
+  palette_context pc;
+
+  /* initialization */
+  S_format = BENCH_FORMAT_CSV;
+  S_num_rows = 0;
+  S_fixed_point = 0;
+
+  max_size = BENCH_NUM_SYNTHETIC_SIZES;
+  output_dir = ".";
+
+  /* read command line arguments */
+  i = 1;
+
+  while (i < argc)
+  {
+    /* output format (csv or json) */
+    if (!strcmp(argv[i], "-f") && (i + 1 < argc))
+    {
+      if (!strcmp(argv[i + 1], "json"))
+        S_format = BENCH_FORMAT_JSON;
+      else if (!strcmp(argv[i + 1], "csv"))
+        S_format = BENCH_FORMAT_CSV;
+      else
+      {
+        fprintf(stderr, "Unknown format %s. Exiting...\n", argv[i + 1]);
+        return 1;
+      }
+
+      i += 2;
+    }
+    /* directory for the output files */
+    else if (!strcmp(argv[i], "-o") && (i + 1 < argc))
+    {
+      output_dir = argv[i + 1];
+      i += 2;
+    }
+    /* number of synthetic sizes to run (0 for built-in sources only) */
+    else if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+    {
+      max_size = atoi(argv[i + 1]);
+
+      if (max_size < 0)
+        max_size = 0;
+      else if (max_size > BENCH_NUM_SYNTHETIC_SIZES)
+        max_size = BENCH_NUM_SYNTHETIC_SIZES;
+
+      i += 2;
+    }
+    /* use the fixed-point decode path */
+    else if (!strcmp(argv[i], "-x"))
+    {
+      S_fixed_point = 1;
+      i += 1;
+    }
+    /* number of worker threads */
+    else if (!strcmp(argv[i], "-j") && (i + 1 < argc))
+    {
+      parallel_set_num_threads(atoi(argv[i + 1]));
+      i += 2;
+    }
+    else
+    {
+      fprintf(stderr, "Unknown command line argument %s. Exiting...\n",
+              argv[i]);
+      return 1;
+    }
+  }
+
+  if (strlen(output_dir) > 200)
+  {
+    fprintf(stderr, "Output directory name is too long. Exiting...\n");
+    return 1;
+  }
+
+  sprintf(S_gpl_filename, "%s/bench.gpl", output_dir);
+  sprintf(S_tga_filename, "%s/bench.tga", output_dir);
+
+  /* print header */
+  if (S_format == BENCH_FORMAT_JSON)
+    printf("[");
+  else
+    printf("palette,colors,phase,reps,seconds,ns_per_color,bytes,mb_per_s\n");
+
+  /* built-in sources */
+  for (source = 0; source < SOURCE_NUM_SOURCES; source++)
+  {
+    if (palette_source_is_custom(source))
+      continue;
+
+    if (palette_init(&pc, source))
+      return 1;
+
+    if (bench_palette(&pc))
+    {
+      palette_deinit(&pc);
+      return 1;
+    }
+
+    palette_deinit(&pc);
+  }
+
+  /* synthetic sizes */
+  for (k = 0; k < max_size; k++)
+  {
+    if (palette_init_custom(&pc,  S_synthetic_sizes[k][0],
+                                  S_synthetic_sizes[k][1]))
+    {
+      return 1;
+    }
+
+    if (bench_palette(&pc))
+    {
+      palette_deinit(&pc);
+      return 1;
+    }
+
+    palette_deinit(&pc);
+  }
+
+  /* signal sizes */
+  for (k = 0; k < BENCH_NUM_SIGNAL_SIZES; k++)
+  {
+    if (palette_init_signal(&pc, S_signal_sizes[k][0], S_signal_sizes[k][1]))
+      return 1;
+
+    if (bench_palette(&pc))
+    {
+      palette_deinit(&pc);
+      return 1;
+    }
+
+    palette_deinit(&pc);
+  }
+
+  /* composite filter frames */
+  for (k = 0; k < BENCH_NUM_NTSC_SIZES; k++)
+  {
+    if (bench_ntsc(S_ntsc_sizes[k][0], S_ntsc_sizes[k][1]))
+    {
+      fprintf(stderr, "Benchmark of ntsc_filter_rows failed.\n");
+      return 1;
+    }
+  }
+
+  if (S_format == BENCH_FORMAT_JSON)
+    printf("\n]\n");
+
+  /* remove output files */
+  remove(S_gpl_filename);
+  remove(S_tga_filename);
+
+  return 0;
+}
@@ -0,0 +1,395 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** blend.c (translucency blend tables)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define BLEND_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "blend.h"
+#include "colormap.h"
+#include "nearest.h"
+#include "output.h"
+#include "palette.h"
+#include "parallel.h"
+
+/* each blended color is looked up in its cell of the nearest */
+/* color index; with sse2, the cell candidates are compared 4 */
+/* at a time, packed as 16-bit pairs (r & g, then b & 0), so  */
+/* one multiply-add gives dr^2 + dg^2 (and the other db^2)    */
+
+/* the candidates are in palette order, & the first of the   */
+/* nearest ones is kept, so the result is the lowest index   */
+/* of the nearest colors (the same as nearest_index_query()) */
+
+/* at 50%, the table is symmetric, so only the entries on & */
+/* above the diagonal are looked up, & the rest are copied  */
+
+#define BLEND_INFINITY  0x7FFFFFFF
+
+enum
+{
+  BLEND_PASS_FILL = 0,
+  BLEND_PASS_MIRROR
+};
+
+typedef struct blend_build
+{
+  nearest_index*  ni;
+  color*          palette;
+  int             num_colors;
+
+  int             alpha;
+  int             symmetric;
+  int             pass;
+
+  /* cell candidates, packed for the sse2 search */
+  int*            rg;
+  int*            b;
+
+  int             bytes_per_entry;
+  unsigned char*  rows;
+} blend_build;
+
+/*******************************************************************************
+** blend_query()
+*******************************************************************************/
+static int blend_query(blend_build* bb, int r, int g, int b)
+{
+#if defined(BLEND_HAVE_SSE2)
+  nearest_index* ni;
+
+  __m128i target_rg;
+  __m128i target_b;
+  __m128i d;
+  __m128i dist;
+  __m128i mask;
+  __m128i pos;
+  __m128i best_dist;
+  __m128i best;
+
+  int     lane_dist[4];
+  int     lane_best[4];
+
+  int     cell;
+  int     start;
+  int     end;
+  int     k;
+  int     j;
+
+  int     dr;
+  int     dg;
+  int     db;
+
+  int     value;
+  int     best_value;
+  int     best_k;
+
+  ni = bb->ni;
+
+  cell =  ((r >> NEAREST_CELL_SHIFT) << (2 * NEAREST_GRID_BITS)) |
+          ((g >> NEAREST_CELL_SHIFT) << NEAREST_GRID_BITS) |
+          (b >> NEAREST_CELL_SHIFT);
+
+  start = ni->cell_start[cell];
+  end = ni->cell_start[cell + 1];
+
+  target_rg = _mm_set1_epi32(r | (g << 16));
+  target_b = _mm_set1_epi32(b);
+
+  best_dist = _mm_set1_epi32(BLEND_INFINITY);
+  best = _mm_setzero_si128();
+  pos = _mm_setr_epi32(start, start + 1, start + 2, start + 3);
+
+  for (k = start; k + 4 <= end; k += 4)
+  {
+    d = _mm_sub_epi16(target_rg, _mm_loadu_si128((__m128i*) &bb->rg[k]));
+    dist = _mm_madd_epi16(d, d);
+
+    d = _mm_sub_epi16(target_b, _mm_loadu_si128((__m128i*) &bb->b[k]));
+    dist = _mm_add_epi32(dist, _mm_madd_epi16(d, d));
+
+    /* each lane keeps the first of its nearest candidates */
+    mask = _mm_cmplt_epi32(dist, best_dist);
+
+    best_dist = _mm_or_si128( _mm_and_si128(mask, dist),
+                              _mm_andnot_si128(mask, best_dist));
+    best = _mm_or_si128(_mm_and_si128(mask, pos),
+                        _mm_andnot_si128(mask, best));
+
+    pos = _mm_add_epi32(pos, _mm_set1_epi32(4));
+  }
+
+  _mm_storeu_si128((__m128i*) lane_dist, best_dist);
+  _mm_storeu_si128((__m128i*) lane_best, best);
+
+  /* the first of the nearest lanes, then the remaining candidates */
+  best_value = lane_dist[0];
+  best_k = lane_best[0];
+
+  for (j = 1; j < 4; j++)
+  {
+    if ((lane_dist[j] < best_value) ||
+        ((lane_dist[j] == best_value) && (lane_best[j] < best_k)))
+    {
+      best_value = lane_dist[j];
+      best_k = lane_best[j];
+    }
+  }
+
+  for (; k < end; k++)
+  {
+    dr = (bb->rg[k] & 0xFFFF) - r;
+    dg = (bb->rg[k] >> 16) - g;
+    db = bb->b[k] - b;
+
+    value = (dr * dr) + (dg * dg) + (db * db);
+
+    if (value < best_value)
+    {
+      best_value = value;
+      best_k = k;
+    }
+  }
+
+  return ni->candidates[best_k];
+#else
+  return nearest_index_query(bb->ni, r, g, b);
+#endif
+}
+
+/*******************************************************************************
+** blend_set_entry()
+*******************************************************************************/
+static void blend_set_entry(blend_build* bb, int a, int b, int index)
+{
+  unsigned char* entry;
+
+  entry = &bb->rows[((long) a * bb->num_colors + b) * bb->bytes_per_entry];
+
+  entry[0] = (unsigned char) (index & 0xFF);
+
+  if (bb->bytes_per_entry >= 2)
+    entry[1] = (unsigned char) ((index >> 8) & 0xFF);
+
+  if (bb->bytes_per_entry == 4)
+  {
+    entry[2] = (unsigned char) ((index >> 16) & 0xFF);
+    entry[3] = (unsigned char) ((index >> 24) & 0xFF);
+  }
+}
+
+/*******************************************************************************
+** blend_fill_row()
+*******************************************************************************/
+static void blend_fill_row(blend_build* bb, int a)
+{
+  color*  ca;
+  color*  cb;
+
+  int     weight;
+  int     r;
+  int     g;
+  int     b;
+  int     k;
+
+  ca = &bb->palette[a];
+  weight = BLEND_MAX_ALPHA - bb->alpha;
+
+  /* a symmetric row starts at the diagonal */
+  for (k = (bb->symmetric ? a : 0); k < bb->num_colors; k++)
+  {
+    cb = &bb->palette[k];
+
+    /* blend (rounded to nearest) */
+    r = (ca->r * bb->alpha + cb->r * weight + BLEND_MAX_ALPHA / 2) /
+        BLEND_MAX_ALPHA;
+    g = (ca->g * bb->alpha + cb->g * weight + BLEND_MAX_ALPHA / 2) /
+        BLEND_MAX_ALPHA;
+    b = (ca->b * bb->alpha + cb->b * weight + BLEND_MAX_ALPHA / 2) /
+        BLEND_MAX_ALPHA;
+
+    blend_set_entry(bb, a, k, blend_query(bb, r, g, b));
+  }
+}
+
+/*******************************************************************************
+** blend_mirror_row()
+*******************************************************************************/
+static void blend_mirror_row(blend_build* bb, int a)
+{
+  unsigned char*  row;
+  unsigned char*  column;
+
+  long  row_bytes;
+  int   k;
+
+  row_bytes = (long) bb->num_colors * bb->bytes_per_entry;
+
+  row = &bb->rows[a * row_bytes];
+  column = &bb->rows[(long) a * bb->bytes_per_entry];
+
+  /* the entries left of the diagonal come from the column */
+  for (k = 0; k < a; k++)
+  {
+    memcpy(row, column, bb->bytes_per_entry);
+
+    row += bb->bytes_per_entry;
+    column += row_bytes;
+  }
+}
+
+/*******************************************************************************
+** blend_job()
+*******************************************************************************/
+static void blend_job(void* data, int index)
+{
+  blend_build* bb;
+
+  int last;
+
+  bb = (blend_build*) data;
+
+  if (bb->pass == BLEND_PASS_MIRROR)
+  {
+    blend_mirror_row(bb, index);
+    return;
+  }
+
+  if (!bb->symmetric)
+  {
+    blend_fill_row(bb, index);
+    return;
+  }
+
+  /* symmetric rows get shorter, so each job pairs a */
+  /* long row with a short one to even out the work  */
+  last = bb->num_colors - 1 - index;
+
+  blend_fill_row(bb, index);
+
+  if (last != index)
+    blend_fill_row(bb, last);
+}
+
+/*******************************************************************************
+** write_blend_file()
+*******************************************************************************/
+short int write_blend_file( palette_context* pc, nearest_index* ni,
+                            int alpha, char* filename)
+{
+  blend_build     bb;
+
+  unsigned char*  buffer;
+  long            num_bytes;
+
+  int num_colors;
+  int k;
+
+  /* make sure alpha is valid */
+  if ((alpha < BLEND_MIN_ALPHA) || (alpha > BLEND_MAX_ALPHA))
+  {
+    printf("Write blend file failed: Alpha must be from %d to %d.\n",
+           BLEND_MIN_ALPHA, BLEND_MAX_ALPHA);
+    return 1;
+  }
+
+  /* make sure palette size is valid */
+  num_colors = pc->num_colors;
+
+  if (num_colors > BLEND_MAX_COLORS)
+  {
+    printf("Write blend file failed: Palettes over %d colors ",
+           BLEND_MAX_COLORS);
+    printf("are not supported.\n");
+    return 1;
+  }
+
+  /* make sure filename is valid */
+  if (filename == NULL)
+  {
+    printf("Write blend file failed: No filename specified.\n");
+    return 1;
+  }
+
+  bb.ni = ni;
+  bb.palette = pc->colors_array;
+  bb.num_colors = num_colors;
+  bb.alpha = alpha;
+  bb.symmetric = (2 * alpha == BLEND_MAX_ALPHA);
+  bb.bytes_per_entry = colormap_bytes_per_entry(num_colors);
+
+  /* pack the cell candidates */
+  bb.rg = malloc(sizeof(int) * (ni->num_candidates + 1));
+  bb.b = malloc(sizeof(int) * (ni->num_candidates + 1));
+
+  num_bytes = (long) num_colors * num_colors * bb.bytes_per_entry;
+
+  buffer = malloc(num_bytes);
+
+  if ((bb.rg == NULL) || (bb.b == NULL) || (buffer == NULL))
+  {
+    printf("Write blend file failed: Out of memory.\n");
+    free(bb.rg);
+    free(bb.b);
+    free(buffer);
+    return 1;
+  }
+
+  for (k = 0; k < ni->num_candidates; k++)
+  {
+    bb.rg[k] = ni->candidate_colors[k].r | (ni->candidate_colors[k].g << 16);
+    bb.b[k] = ni->candidate_colors[k].b;
+  }
+
+  bb.rows = buffer;
+
+  /* build the table in memory, a row (or a pair of rows) per job */
+  bb.pass = BLEND_PASS_FILL;
+
+  if (parallel_run( bb.symmetric ? (num_colors + 1) / 2 : num_colors,
+                    blend_job, &bb))
+  {
+    free(bb.rg);
+    free(bb.b);
+    free(buffer);
+    return 1;
+  }
+
+  if (bb.symmetric)
+  {
+    bb.pass = BLEND_PASS_MIRROR;
+
+    if (parallel_run(num_colors, blend_job, &bb))
+    {
+      free(bb.rg);
+      free(bb.b);
+      free(buffer);
+      return 1;
+    }
+  }
+
+  free(bb.rg);
+  free(bb.b);
+
+  /* write out the file (if it changed) */
+  if (replace_output_file(filename, (char*) buffer, num_bytes))
+  {
+    printf("Write blend file failed: Unable to write table.\n");
+    free(buffer);
+    return 1;
+  }
+
+  free(buffer);
+
+  return 0;
+}
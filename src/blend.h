@@ -0,0 +1,30 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** blend.h (translucency blend tables)
+*******************************************************************************/
+
+#ifndef BLEND_H
+#define BLEND_H
+
+#include "nearest.h"
+#include "palette.h"
+
+/* the entry at row a, column b is the index of the nearest */
+/* color to alpha * a + (1 - alpha) * b, with alpha given   */
+/* as a percentage; the table is laid out like a colormap   */
+/* (no header, & 1, 2 or 4 byte entries, least significant */
+/* byte first), with one row per palette color              */
+#define BLEND_MIN_ALPHA   0
+#define BLEND_MAX_ALPHA   100
+
+/* larger palettes would need tables of over 32 MB */
+#define BLEND_MAX_COLORS  4096
+
+/* function declarations */
+short int write_blend_file( palette_context* pc, nearest_index* ni,
+                            int alpha, char* filename);
+
+#endif
@@ -0,0 +1,39 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** builtin.h (built-in palettes, generated at build time)
+*******************************************************************************/
+
+#ifndef BUILTIN_H
+#define BUILTIN_H
+
+#include "palette.h"
+
+/* the tables & colors for one of the built-in sources, */
+/* as generated by tools/gen_builtin.c (the entry for   */
+/* the custom source is empty)                          */
+typedef struct palette_builtin
+{
+  int           num_colors;
+  int           num_clamped;
+
+  const float*  luma_table;
+  const float*  saturation_table;
+  int           table_length;
+
+  const double* cos_table;
+  const double* sin_table;
+  int           num_hues;
+
+  const color*  colors;
+} palette_builtin;
+
+/* the generated table (obj/builtin.c); palette.c is built  */
+/* without it (PALETTE_NO_BUILTIN) for the generator itself */
+#ifndef PALETTE_NO_BUILTIN
+extern const palette_builtin palette_builtins[SOURCE_NUM_SOURCES];
+#endif
+
+#endif
@@ -0,0 +1,347 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** cache.c (content-addressed output file cache)
+*******************************************************************************/
+
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L
+#define CACHE_HAVE_POSIX
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(CACHE_HAVE_POSIX)
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include "cache.h"
+#include "palette.h"
+
+/* bump this whenever the generated output changes, */
+/* so that older cache entries are no longer found  */
+#define CACHE_VERSION 2
+
+#define CACHE_PATH_LENGTH   512
+#define CACHE_COPY_SIZE     (1 << 20)
+
+/*******************************************************************************
+** cache_hash()
+*******************************************************************************/
+static void cache_hash(char* text, char* key)
+{
+  unsigned long h[4];
+  unsigned long r[4];
+  unsigned long carry;
+
+  int k;
+
+  /* 64-bit fnv-1a, kept as four 16-bit limbs (least */
+  /* significant first), since c90 has no 64-bit type */
+  h[0] = 0x2325;
+  h[1] = 0x8422;
+  h[2] = 0x9CE4;
+  h[3] = 0xCBF2;
+
+  for (; *text != '\0'; text++)
+  {
+    h[0] ^= (unsigned char) *text;
+
+    /* multiply by the prime (2^40 + 0x1B3), modulo 2^64 */
+    r[0] = h[0] * 0x1B3;
+    r[1] = h[1] * 0x1B3;
+    r[2] = h[2] * 0x1B3 + (h[0] << 8);
+    r[3] = h[3] * 0x1B3 + (h[1] << 8);
+
+    carry = 0;
+
+    for (k = 0; k < 4; k++)
+    {
+      r[k] += carry;
+      h[k] = r[k] & 0xFFFF;
+      carry = r[k] >> 16;
+    }
+  }
+
+  sprintf(key, "%04lx%04lx%04lx%04lx", h[3], h[2], h[1], h[0]);
+}
+
+/*******************************************************************************
+** cache_make_key()
+*******************************************************************************/
+void cache_make_key(palette_context* pc, char* extension, int param, char* key)
+{
+  char text[256];
+
+  /* everything that changes the contents of the output file */
+  sprintf(text, "palette-cache-%d source=%d table=%d hues=%d fixed=%d "
+                "signal=%d,%d,%d format=%.16s param=%d",
+          CACHE_VERSION, pc->source, pc->table_length, pc->num_hues,
+          pc->fixed_point, pc->signal_rate, pc->signal_filter,
+          pc->signal_taps, extension, param);
+
+  cache_hash(text, key);
+}
+
+/*******************************************************************************
+** cache_path()
+*******************************************************************************/
+static short int cache_path(char* path, char* dir, char* key, char* extension,
+                            char* suffix)
+{
+  if (strlen(dir) + strlen(key) + strlen(extension) + strlen(suffix) + 2 >
+      CACHE_PATH_LENGTH)
+  {
+    return 1;
+  }
+
+  sprintf(path, "%s/%s%s%s", dir, key, extension, suffix);
+
+  return 0;
+}
+
+/*******************************************************************************
+** cache_temp_suffix()
+*******************************************************************************/
+static void cache_temp_suffix(char* suffix)
+{
+  /* each process uses its own temporary files, & a key is */
+  /* only ever stored by one thread of a process at a time */
+#if defined(CACHE_HAVE_POSIX)
+  sprintf(suffix, ".%ld.tmp", (long) getpid());
+#else
+  strcpy(suffix, ".tmp");
+#endif
+}
+
+/*******************************************************************************
+** cache_copy_file()
+*******************************************************************************/
+static short int cache_copy_file(char* src, char* dst)
+{
+  FILE* fp_in;
+  FILE* fp_out;
+
+  char* buffer;
+  size_t n;
+
+  buffer = malloc(CACHE_COPY_SIZE);
+
+  if (buffer == NULL)
+    return 1;
+
+  fp_in = fopen(src, "rb");
+
+  if (fp_in == NULL)
+  {
+    free(buffer);
+    return 1;
+  }
+
+  fp_out = fopen(dst, "wb");
+
+  if (fp_out == NULL)
+  {
+    fclose(fp_in);
+    free(buffer);
+    return 1;
+  }
+
+  while ((n = fread(buffer, 1, CACHE_COPY_SIZE, fp_in)) > 0)
+  {
+    if (fwrite(buffer, 1, n, fp_out) < n)
+      break;
+  }
+
+  if (ferror(fp_in) || ferror(fp_out))
+  {
+    fclose(fp_in);
+    fclose(fp_out);
+    remove(dst);
+    free(buffer);
+    return 1;
+  }
+
+  fclose(fp_in);
+
+  if (fclose(fp_out))
+  {
+    remove(dst);
+    free(buffer);
+    return 1;
+  }
+
+  free(buffer);
+
+  return 0;
+}
+
+/*******************************************************************************
+** cache_files_match()
+*******************************************************************************/
+static int cache_files_match(char* a, char* b)
+{
+  FILE* fp_a;
+  FILE* fp_b;
+
+  char* buffer_a;
+  char* buffer_b;
+
+  size_t  n_a;
+  size_t  n_b;
+  int     matches;
+
+  fp_a = fopen(a, "rb");
+
+  if (fp_a == NULL)
+    return 0;
+
+  fp_b = fopen(b, "rb");
+
+  if (fp_b == NULL)
+  {
+    fclose(fp_a);
+    return 0;
+  }
+
+  buffer_a = malloc(CACHE_COPY_SIZE);
+  buffer_b = malloc(CACHE_COPY_SIZE);
+
+  /* compare a chunk at a time (both files must end together) */
+  matches = (buffer_a != NULL) && (buffer_b != NULL);
+
+  while (matches)
+  {
+    n_a = fread(buffer_a, 1, CACHE_COPY_SIZE, fp_a);
+    n_b = fread(buffer_b, 1, CACHE_COPY_SIZE, fp_b);
+
+    if ((n_a != n_b) || memcmp(buffer_a, buffer_b, n_a))
+      matches = 0;
+    else if (n_a < CACHE_COPY_SIZE)
+      break;
+  }
+
+  if (ferror(fp_a) || ferror(fp_b))
+    matches = 0;
+
+  fclose(fp_a);
+  fclose(fp_b);
+
+  free(buffer_a);
+  free(buffer_b);
+
+  return matches;
+}
+
+/*******************************************************************************
+** cache_place_file()
+*******************************************************************************/
+static short int cache_place_file(char* src, char* dst, char* temp)
+{
+  /* copy to a temporary name, then rename it into place, so  */
+  /* that readers never see a partial file (the file is not   */
+  /* linked, since editing the output in place would then     */
+  /* change the cache entry too)                              */
+  remove(temp);
+
+  if (cache_copy_file(src, temp))
+    return 1;
+
+  if (rename(temp, dst))
+  {
+    remove(temp);
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** cache_fetch()
+*******************************************************************************/
+short int cache_fetch(char* dir, char* key, char* extension, char* filename)
+{
+  char  path[CACHE_PATH_LENGTH];
+  char  temp[CACHE_PATH_LENGTH];
+  char  suffix[32];
+
+  FILE* fp;
+
+  if ((dir == NULL) || (filename == NULL))
+    return 1;
+
+  if (cache_path(path, dir, key, extension, ""))
+    return 1;
+
+  /* miss */
+  fp = fopen(path, "rb");
+
+  if (fp == NULL)
+    return 1;
+
+  fclose(fp);
+
+  /* hit (an output that is already the same is left alone, */
+  /* & its modification time kept; otherwise it is replaced */
+  /* by a copy of the entry)                                */
+  if (cache_files_match(path, filename))
+    return 0;
+
+  cache_temp_suffix(suffix);
+
+  if (strlen(filename) + strlen(suffix) + 1 > CACHE_PATH_LENGTH)
+    return 1;
+
+  strcpy(temp, filename);
+  strcat(temp, suffix);
+
+  return cache_place_file(path, filename, temp);
+}
+
+/*******************************************************************************
+** cache_store()
+*******************************************************************************/
+short int cache_store(char* dir, char* key, char* extension, char* filename)
+{
+  char  path[CACHE_PATH_LENGTH];
+  char  temp[CACHE_PATH_LENGTH];
+  char  suffix[32];
+
+  if ((dir == NULL) || (filename == NULL))
+    return 1;
+
+#if defined(CACHE_HAVE_POSIX)
+  /* create the cache directory (if it is not there already) */
+  mkdir(dir, 0755);
+#endif
+
+  cache_temp_suffix(suffix);
+
+  if (cache_path(path, dir, key, extension, "") ||
+      cache_path(temp, dir, key, extension, suffix))
+  {
+    printf("Unable to store %s in cache: Path is too long.\n", filename);
+    return 1;
+  }
+
+  /* an entry that is already there is left alone */
+  if (cache_files_match(filename, path))
+    return 0;
+
+  /* concurrent builds may store the same entry at the same time, */
+  /* which is fine, since the contents are the same & the rename  */
+  /* of a complete file is atomic                                 */
+  if (cache_place_file(filename, path, temp))
+  {
+    printf("Unable to store %s in cache.\n", filename);
+    return 1;
+  }
+
+  return 0;
+}
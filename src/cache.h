@@ -0,0 +1,24 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** cache.h (content-addressed output file cache)
+*******************************************************************************/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "palette.h"
+
+/* the key is 16 hex digits (a 64-bit hash) */
+#define CACHE_KEY_LENGTH 17
+
+/* function declarations */
+void      cache_make_key( palette_context* pc, char* extension, int param,
+                          char* key);
+
+short int cache_fetch(char* dir, char* key, char* extension, char* filename);
+short int cache_store(char* dir, char* key, char* extension, char* filename);
+
+#endif
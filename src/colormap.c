@@ -0,0 +1,159 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** colormap.c (light level colormap tables)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "colormap.h"
+#include "nearest.h"
+#include "output.h"
+#include "palette.h"
+#include "parallel.h"
+
+typedef struct colormap_build
+{
+  nearest_index*  ni;
+  color*          palette;
+  int             num_colors;
+
+  int             num_levels;
+  color           fog;
+
+  int             bytes_per_entry;
+  unsigned char*  rows;
+} colormap_build;
+
+/*******************************************************************************
+** colormap_bytes_per_entry()
+*******************************************************************************/
+int colormap_bytes_per_entry(int num_colors)
+{
+  if (num_colors <= 256)
+    return 1;
+  else if (num_colors <= 65536)
+    return 2;
+  else
+    return 4;
+}
+
+/*******************************************************************************
+** colormap_fill_level()
+*******************************************************************************/
+static void colormap_fill_level(void* data, int level)
+{
+  colormap_build* cb;
+  color*          c;
+  unsigned char*  entry;
+
+  int weight;
+  int index;
+  int r;
+  int g;
+  int b;
+  int n;
+  int k;
+
+  cb = (colormap_build*) data;
+
+  /* each level is one contiguous row */
+  entry = &cb->rows[(long) level * cb->num_colors * cb->bytes_per_entry];
+
+  n = cb->num_levels;
+  weight = n - level;
+
+  for (k = 0; k < cb->num_colors; k++)
+  {
+    c = &cb->palette[k];
+
+    /* blend toward the fog color (rounded to nearest) */
+    r = (c->r * weight + cb->fog.r * level + n / 2) / n;
+    g = (c->g * weight + cb->fog.g * level + n / 2) / n;
+    b = (c->b * weight + cb->fog.b * level + n / 2) / n;
+
+    index = nearest_index_query(cb->ni, r, g, b);
+
+    entry[0] = (unsigned char) (index & 0xFF);
+
+    if (cb->bytes_per_entry >= 2)
+      entry[1] = (unsigned char) ((index >> 8) & 0xFF);
+
+    if (cb->bytes_per_entry == 4)
+    {
+      entry[2] = (unsigned char) ((index >> 16) & 0xFF);
+      entry[3] = (unsigned char) ((index >> 24) & 0xFF);
+    }
+
+    entry += cb->bytes_per_entry;
+  }
+}
+
+/*******************************************************************************
+** write_colormap_file()
+*******************************************************************************/
+short int write_colormap_file(palette_context* pc, nearest_index* ni,
+                              int num_levels, color fog, char* filename)
+{
+  colormap_build  cb;
+
+  unsigned char*  buffer;
+  long            num_bytes;
+
+  /* make sure number of levels is valid */
+  if ((num_levels < COLORMAP_MIN_LEVELS) ||
+      (num_levels > COLORMAP_MAX_LEVELS))
+  {
+    printf("Write colormap file failed: Levels must be from %d to %d.\n",
+           COLORMAP_MIN_LEVELS, COLORMAP_MAX_LEVELS);
+    return 1;
+  }
+
+  /* make sure filename is valid */
+  if (filename == NULL)
+  {
+    printf("Write colormap file failed: No filename specified.\n");
+    return 1;
+  }
+
+  cb.ni = ni;
+  cb.palette = pc->colors_array;
+  cb.num_colors = pc->num_colors;
+  cb.num_levels = num_levels;
+  cb.fog = fog;
+  cb.bytes_per_entry = colormap_bytes_per_entry(pc->num_colors);
+
+  /* build the table in memory, one level per job */
+  num_bytes = (long) num_levels * pc->num_colors * cb.bytes_per_entry;
+
+  buffer = malloc(num_bytes);
+
+  if (buffer == NULL)
+  {
+    printf("Write colormap file failed: Out of memory.\n");
+    return 1;
+  }
+
+  cb.rows = buffer;
+
+  if (parallel_run(num_levels, colormap_fill_level, &cb))
+  {
+    free(buffer);
+    return 1;
+  }
+
+  /* write out the file (if it changed) */
+  if (replace_output_file(filename, (char*) buffer, num_bytes))
+  {
+    printf("Write colormap file failed: Unable to write table.\n");
+    free(buffer);
+    return 1;
+  }
+
+  free(buffer);
+
+  return 0;
+}
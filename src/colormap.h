@@ -0,0 +1,31 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** colormap.h (light level colormap tables)
+*******************************************************************************/
+
+#ifndef COLORMAP_H
+#define COLORMAP_H
+
+#include "nearest.h"
+#include "palette.h"
+
+/* each level is a row with one entry per palette color, giving the */
+/* index of the nearest color to that color blended toward the fog */
+/* color (black to darken) by level / num_levels; so the first row  */
+/* is full brightness, and the last is one step short of the fog    */
+#define COLORMAP_MIN_LEVELS 1
+#define COLORMAP_MAX_LEVELS 128
+
+/* there is no header; the entries are 1 byte for palettes up to 256 */
+/* colors, and otherwise 2 or 4 bytes, least significant byte first */
+
+/* function declarations */
+int       colormap_bytes_per_entry(int num_colors);
+
+short int write_colormap_file(palette_context* pc, nearest_index* ni,
+                              int num_levels, color fog, char* filename);
+
+#endif
@@ -0,0 +1,522 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** fixed.c (fixed-point yiq to rgb conversion)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__) && defined(__SSE2__) && defined(__x86_64__)
+#define FIXED_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+#include "fixed.h"
+#include "palette.h"
+#include "yiq.h"
+
+/* the fixed-point path only uses integer math, with every */
+/* intermediate value kept within a 32-bit int, so the     */
+/* palettes are the same on every compiler & platform     */
+
+/* approx nes tables in Q16 (0.2, 0.35, 0.65, 0.85 & 0.2, 0.35, 0.35, 0.15) */
+static int S_fixed_approx_nes_lum[4] = {13107, 22938, 42598, 55706};
+static int S_fixed_approx_nes_sat[4] = {13107, 22938, 22938,  9830};
+
+/* yiq to rgb matrix in Q12 (the i & q coefficients for r, g, b) */
+static int S_fixed_matrix[3][2] =
+  { { 3916,  2535},   /*  0.956,  0.619 */
+    {-1114, -2650},   /* -0.272, -0.647 */
+    {-4530,  6975}    /* -1.106,  1.703 */
+  };
+
+/* cordic angles, atan(2^-i), in turns (2^32 = one turn) */
+#define FIXED_CORDIC_STEPS 30
+
+static int S_fixed_cordic_angles[FIXED_CORDIC_STEPS] =
+  { 536870912,  316933406,  167458907,  85004756,   42667331,
+    21354465,   10679838,   5340245,    2670163,    1335087,
+    667544,     333772,     166886,     83443,      41722,
+    20861,      10430,      5215,       2608,       1304,
+    652,        326,        163,        81,         41,
+    20,         10,         5,          3,          1
+  };
+
+/* the cordic gain (the product of 1/sqrt(1 + 2^-2i)) in Q30 */
+#define FIXED_CORDIC_GAIN 652032874
+
+/*******************************************************************************
+** fixed_shift()
+*******************************************************************************/
+static int fixed_shift(int value, int shift)
+{
+  /* floor(value / 2^shift); the value is biased to be positive */
+  /* first, since shifting a negative number right is            */
+  /* implementation-defined in c                                 */
+  if (shift == 0)
+    return value;
+
+  return  (int) (((unsigned int) value + 0x80000000U) >> shift) -
+          (int) (0x80000000U >> shift);
+}
+
+/*******************************************************************************
+** fixed_ratio()
+*******************************************************************************/
+static int fixed_ratio(unsigned long num, unsigned long den)
+{
+  unsigned long hi;
+  unsigned long rem;
+
+  /* round(num * 65536 / den), in two steps of 8 bits, */
+  /* so that nothing overflows (num < den < 2^24)      */
+  hi = (num << 8) / den;
+  rem = (num << 8) % den;
+
+  return (int) ((hi << 8) + (((rem << 8) + (den / 2)) / den));
+}
+
+/*******************************************************************************
+** fixed_turn()
+*******************************************************************************/
+static unsigned long fixed_turn(unsigned long num, unsigned long den)
+{
+  unsigned long turn;
+  unsigned long rem;
+
+  int k;
+
+  /* the fraction of a turn num / den, with 2^32 = one turn */
+  /* (long division by bytes, so den can be up to 2^24)    */
+  turn = 0;
+  rem = num % den;
+
+  for (k = 0; k < 4; k++)
+  {
+    rem <<= 8;
+
+    turn = (turn << 8) | (rem / den);
+    rem = rem % den;
+  }
+
+  return turn & 0xFFFFFFFFUL;
+}
+
+/*******************************************************************************
+** fixed_phasor()
+*******************************************************************************/
+void fixed_phasor(unsigned long turn, int* cos_hue, int* sin_hue)
+{
+  unsigned long quadrant;
+  unsigned long d;
+
+  int   x;
+  int   y;
+  int   z;
+  int   t;
+
+  int   k;
+
+  /* split the angle into a quarter turn & a remainder within */
+  /* +/- 1/8 turn (well inside the range where cordic works)   */
+  turn &= 0xFFFFFFFFUL;
+
+  quadrant = ((turn + 0x20000000UL) >> 30) & 3;
+  d = (turn - (quadrant << 30)) & 0xFFFFFFFFUL;
+
+  if (d & 0x80000000UL)
+    z = -(int) (((~d) + 1) & 0xFFFFFFFFUL);
+  else
+    z = (int) d;
+
+  /* rotate (gain, 0) by the remainder */
+  x = FIXED_CORDIC_GAIN;
+  y = 0;
+
+  for (k = 0; k < FIXED_CORDIC_STEPS; k++)
+  {
+    t = x;
+
+    if (z >= 0)
+    {
+      x = x - fixed_shift(y, k);
+      y = y + fixed_shift(t, k);
+      z = z - S_fixed_cordic_angles[k];
+    }
+    else
+    {
+      x = x + fixed_shift(y, k);
+      y = y - fixed_shift(t, k);
+      z = z + S_fixed_cordic_angles[k];
+    }
+  }
+
+  /* rotate by the quarter turns */
+  if (quadrant == 0)
+  {
+    *cos_hue = x;
+    *sin_hue = y;
+  }
+  else if (quadrant == 1)
+  {
+    *cos_hue = -y;
+    *sin_hue = x;
+  }
+  else if (quadrant == 2)
+  {
+    *cos_hue = -x;
+    *sin_hue = -y;
+  }
+  else
+  {
+    *cos_hue = y;
+    *sin_hue = -x;
+  }
+}
+
+/*******************************************************************************
+** fixed_voltage_tables()
+*******************************************************************************/
+short int fixed_voltage_tables(palette_context* pc)
+{
+  int   k;
+  int   n;
+
+  int* lum;
+  int* sat;
+
+  unsigned long num;
+  unsigned long den;
+
+  n = pc->table_length;
+
+  /* allocate tables (the first time the fixed-point path is used) */
+  if (pc->luma_fixed == NULL)
+    pc->luma_fixed = malloc(sizeof(int) * n);
+
+  if (pc->saturation_fixed == NULL)
+    pc->saturation_fixed = malloc(sizeof(int) * n);
+
+  if ((pc->luma_fixed == NULL) || (pc->saturation_fixed == NULL))
+  {
+    printf("Cannot generate voltage tables: Out of memory.\n");
+    return 1;
+  }
+
+  lum = pc->luma_fixed;
+  sat = pc->saturation_fixed;
+
+  /* approx nes tables */
+  if ((pc->source == SOURCE_APPROX_NES) ||
+      (pc->source == SOURCE_APPROX_NES_ROTATED))
+  {
+    for (k = 0; k < 4; k++)
+    {
+      lum[k] = S_fixed_approx_nes_lum[k];
+      sat[k] = S_fixed_approx_nes_sat[k];
+    }
+
+    return 0;
+  }
+
+  /* composite tables (the same steps as the float tables, */
+  /* but as exact ratios, so nothing depends on rounding)  */
+  if ((pc->source == SOURCE_COMPOSITE_08)         ||
+      (pc->source == SOURCE_COMPOSITE_16)         ||
+      (pc->source == SOURCE_COMPOSITE_16_ROTATED))
+  {
+    den = 18;
+  }
+  else if (pc->source == SOURCE_COMPOSITE_32)
+    den = 34;
+  else if (pc->source == SOURCE_COMPOSITE_CUSTOM)
+    den = n + 2;
+  else
+  {
+    printf("Cannot generate voltage tables; invalid source specified.\n");
+    return 1;
+  }
+
+  for (k = 0; k < n / 2; k++)
+  {
+    /* the composite 08 table should include steps 1, 3, 6, and 8 */
+    if (pc->source == SOURCE_COMPOSITE_08)
+      num = (k < 2) ? (2 * k + 1) : (2 * k + 2);
+    else
+      num = k + 1;
+
+    lum[k] = fixed_ratio(num, den);
+    lum[n - 1 - k] = FIXED_VOLTAGE_ONE - lum[k];
+
+    sat[k] = lum[k];
+    sat[n - 1 - k] = sat[k];
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** fixed_phasor_tables()
+*******************************************************************************/
+short int fixed_phasor_tables(palette_context* pc)
+{
+  int   m;
+  int   k;
+
+  int   hue;
+  int   step;
+
+  int   cos_hue;
+  int   sin_hue;
+
+  unsigned long turn;
+
+  int* coefs;
+
+  /* allocate table (the first time the fixed-point path is used) */
+  if (pc->phasor_fixed == NULL)
+    pc->phasor_fixed = malloc(sizeof(int) * 3 * pc->num_hues);
+
+  if (pc->phasor_fixed == NULL)
+  {
+    printf("Cannot generate phasor tables: Out of memory.\n");
+    return 1;
+  }
+
+  hue = 0;
+  step = 30;
+
+  if (pc->source == SOURCE_APPROX_NES_ROTATED)
+    hue = 15;
+
+  for (m = 0; m < pc->num_hues; m++)
+  {
+    /* approx nes phasors (in whole degrees) */
+    if ((pc->source == SOURCE_APPROX_NES) ||
+        (pc->source == SOURCE_APPROX_NES_ROTATED))
+    {
+      turn = fixed_turn(hue, 360);
+
+      hue += step;
+      hue = hue % 360;
+    }
+    /* composite 16 rotated phasors (phi is 1/24 of a turn) */
+    else if (pc->source == SOURCE_COMPOSITE_16_ROTATED)
+      turn = fixed_turn(24 * m + pc->num_hues, 24 * pc->num_hues);
+    /* composite phasors */
+    else
+      turn = fixed_turn(m, pc->num_hues);
+
+    fixed_phasor(turn, &cos_hue, &sin_hue);
+
+    /* the phasor only matters through the matrix, so the */
+    /* two are folded into one coefficient per channel    */
+    cos_hue = fixed_shift(cos_hue + (1 << 15), 16);
+    sin_hue = fixed_shift(sin_hue + (1 << 15), 16);
+
+    coefs = &pc->phasor_fixed[3 * m];
+
+    for (k = 0; k < 3; k++)
+    {
+      coefs[k] = fixed_shift( (S_fixed_matrix[k][0] * cos_hue) +
+                              (S_fixed_matrix[k][1] * sin_hue) + (1 << 12),
+                              13);
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** fixed_convert_column_scalar()
+*******************************************************************************/
+static int fixed_convert_column_scalar( int* luma, int* saturation, int length,
+                                        int* coefs, color* output)
+{
+  int   k;
+  int   num_clamped;
+
+  int   y;
+  int   s;
+
+  int   r;
+  int   g;
+  int   b;
+
+  num_clamped = 0;
+
+  for (k = 0; k < length; k++)
+  {
+    y = luma[k];
+    s = saturation[k];
+
+    /* y + (s * coef) in Q16, then scaled to 0-255 with rounding */
+    r = y + fixed_shift((s * coefs[0]) + (1 << 12), FIXED_COEF_SHIFT);
+    g = y + fixed_shift((s * coefs[1]) + (1 << 12), FIXED_COEF_SHIFT);
+    b = y + fixed_shift((s * coefs[2]) + (1 << 12), FIXED_COEF_SHIFT);
+
+    r = fixed_shift((r * 255) + (1 << 15), 16);
+    g = fixed_shift((g * 255) + (1 << 15), 16);
+    b = fixed_shift((b * 255) + (1 << 15), 16);
+
+    /* count colors that are outside of the rgb cube */
+    if ((r < 0) || (r > 255) || (g < 0) || (g > 255) || (b < 0) || (b > 255))
+      num_clamped += 1;
+
+    /* bound rgb values */
+    if (r < 0)
+      r = 0;
+    else if (r > 255)
+      r = 255;
+
+    if (g < 0)
+      g = 0;
+    else if (g > 255)
+      g = 255;
+
+    if (b < 0)
+      b = 0;
+    else if (b > 255)
+      b = 255;
+
+    output[k].r = (unsigned char) r;
+    output[k].g = (unsigned char) g;
+    output[k].b = (unsigned char) b;
+  }
+
+  return num_clamped;
+}
+
+#if defined(FIXED_HAVE_AVX2)
+/*******************************************************************************
+** fixed_convert_column_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static int fixed_convert_column_avx2( int* luma, int* saturation, int length,
+                                      int* coefs, color* output)
+{
+  int     k;
+  int     n;
+  int     num_clamped;
+
+  __m256i coef_r;
+  __m256i coef_g;
+  __m256i coef_b;
+
+  __m256i y_8;
+  __m256i s_8;
+
+  __m256i r_8;
+  __m256i g_8;
+  __m256i b_8;
+
+  __m256i out_8;
+  __m256i rgb;
+
+  unsigned char lanes[32];
+
+  num_clamped = 0;
+
+  coef_r = _mm256_set1_epi32(coefs[0]);
+  coef_g = _mm256_set1_epi32(coefs[1]);
+  coef_b = _mm256_set1_epi32(coefs[2]);
+
+  for (k = 0; k + 8 <= length; k += 8)
+  {
+    y_8 = _mm256_loadu_si256((__m256i*) &luma[k]);
+    s_8 = _mm256_loadu_si256((__m256i*) &saturation[k]);
+
+    /* the arithmetic shifts round toward negative infinity, */
+    /* which is exactly what fixed_shift() does               */
+    r_8 = _mm256_add_epi32(y_8,
+            _mm256_srai_epi32(
+              _mm256_add_epi32( _mm256_mullo_epi32(s_8, coef_r),
+                                _mm256_set1_epi32(1 << 12)),
+              FIXED_COEF_SHIFT));
+    g_8 = _mm256_add_epi32(y_8,
+            _mm256_srai_epi32(
+              _mm256_add_epi32( _mm256_mullo_epi32(s_8, coef_g),
+                                _mm256_set1_epi32(1 << 12)),
+              FIXED_COEF_SHIFT));
+    b_8 = _mm256_add_epi32(y_8,
+            _mm256_srai_epi32(
+              _mm256_add_epi32( _mm256_mullo_epi32(s_8, coef_b),
+                                _mm256_set1_epi32(1 << 12)),
+              FIXED_COEF_SHIFT));
+
+    r_8 = _mm256_srai_epi32(
+            _mm256_add_epi32( _mm256_mullo_epi32(r_8, _mm256_set1_epi32(255)),
+                              _mm256_set1_epi32(1 << 15)), 16);
+    g_8 = _mm256_srai_epi32(
+            _mm256_add_epi32( _mm256_mullo_epi32(g_8, _mm256_set1_epi32(255)),
+                              _mm256_set1_epi32(1 << 15)), 16);
+    b_8 = _mm256_srai_epi32(
+            _mm256_add_epi32( _mm256_mullo_epi32(b_8, _mm256_set1_epi32(255)),
+                              _mm256_set1_epi32(1 << 15)), 16);
+
+    /* count colors with any channel outside of 0-255 */
+    out_8 = _mm256_or_si256(
+              _mm256_or_si256(
+                _mm256_cmpgt_epi32(_mm256_setzero_si256(), r_8),
+                _mm256_cmpgt_epi32(r_8, _mm256_set1_epi32(255))),
+              _mm256_or_si256(
+                _mm256_or_si256(
+                  _mm256_cmpgt_epi32(_mm256_setzero_si256(), g_8),
+                  _mm256_cmpgt_epi32(g_8, _mm256_set1_epi32(255))),
+                _mm256_or_si256(
+                  _mm256_cmpgt_epi32(_mm256_setzero_si256(), b_8),
+                  _mm256_cmpgt_epi32(b_8, _mm256_set1_epi32(255)))));
+
+    num_clamped += __builtin_popcount(
+                    _mm256_movemask_ps(_mm256_castsi256_ps(out_8)));
+
+    /* bound to 0-255 with saturating packs (the packs work  */
+    /* within each 128-bit lane, so lane 0 holds colors 0-3 */
+    /* and lane 1 holds colors 4-7)                         */
+    rgb = _mm256_packus_epi16(_mm256_packs_epi32(r_8, g_8),
+                              _mm256_packs_epi32(b_8, _mm256_setzero_si256()));
+
+    _mm256_storeu_si256((__m256i*) lanes, rgb);
+
+    for (n = 0; n < 4; n++)
+    {
+      output[k + n].r = lanes[n];
+      output[k + n].g = lanes[n + 4];
+      output[k + n].b = lanes[n + 8];
+
+      output[k + n + 4].r = lanes[n + 16];
+      output[k + n + 4].g = lanes[n + 20];
+      output[k + n + 4].b = lanes[n + 24];
+    }
+  }
+
+  /* convert remaining colors */
+  num_clamped += fixed_convert_column_scalar( &luma[k], &saturation[k],
+                                              length - k, coefs, &output[k]);
+
+  return num_clamped;
+}
+#endif
+
+/*******************************************************************************
+** fixed_convert_column()
+*******************************************************************************/
+int fixed_convert_column( int* luma, int* saturation, int length,
+                          int* coefs, color* output)
+{
+  /* the integer kernels give the same results, so the */
+  /* simd one is used whenever the processor has it    */
+#if defined(FIXED_HAVE_AVX2)
+  if (yiq_kernel() == YIQ_KERNEL_AVX2)
+  {
+    return fixed_convert_column_avx2( luma, saturation, length,
+                                      coefs, output);
+  }
+#endif
+
+  return fixed_convert_column_scalar( luma, saturation, length,
+                                      coefs, output);
+}
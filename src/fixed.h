@@ -0,0 +1,29 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** fixed.h (fixed-point yiq to rgb conversion)
+*******************************************************************************/
+
+#ifndef FIXED_H
+#define FIXED_H
+
+#include "palette.h"
+
+/* the voltage tables are in Q16 (65536 = 1.0), the phasors */
+/* are in Q30, and the per-hue rgb coefficients are in Q13  */
+#define FIXED_VOLTAGE_ONE (1 << 16)
+#define FIXED_PHASOR_ONE  (1 << 30)
+#define FIXED_COEF_SHIFT  13
+
+/* function declarations */
+void      fixed_phasor(unsigned long turn, int* cos_hue, int* sin_hue);
+
+short int fixed_voltage_tables(palette_context* pc);
+short int fixed_phasor_tables(palette_context* pc);
+
+int       fixed_convert_column( int* luma, int* saturation, int length,
+                                int* coefs, color* output);
+
+#endif
@@ -0,0 +1,681 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** image.c (streaming image input & output)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+#include "palette.h"
+
+/* largest width or height accepted for input images */
+#define IMAGE_MAX_DIMENSION 65535
+
+/*******************************************************************************
+** image_read_ppm_value()
+*******************************************************************************/
+static int image_read_ppm_value(FILE* fp)
+{
+  int c;
+  int value;
+
+  /* skip whitespace & comments */
+  c = fgetc(fp);
+
+  while (1)
+  {
+    if (c == '#')
+    {
+      while ((c != '\n') && (c != EOF))
+        c = fgetc(fp);
+    }
+    else if ((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n'))
+      c = fgetc(fp);
+    else
+      break;
+  }
+
+  if ((c < '0') || (c > '9'))
+    return -1;
+
+  /* read digits (the single whitespace character */
+  /* after the value is consumed along with it)   */
+  value = 0;
+
+  while ((c >= '0') && (c <= '9'))
+  {
+    if (value > IMAGE_MAX_DIMENSION)
+      return -1;
+
+    value = (10 * value) + (c - '0');
+    c = fgetc(fp);
+  }
+
+  return value;
+}
+
+/*******************************************************************************
+** image_open_ppm()
+*******************************************************************************/
+static short int image_open_ppm(image_reader* ir)
+{
+  ir->format = IMAGE_FORMAT_PPM;
+
+  ir->width = image_read_ppm_value(ir->fp);
+  ir->height = image_read_ppm_value(ir->fp);
+  ir->maxval = image_read_ppm_value(ir->fp);
+
+  if ((ir->width <= 0) || (ir->height <= 0))
+  {
+    printf("Read image failed: Invalid PPM dimensions.\n");
+    return 1;
+  }
+
+  /* only 8-bit samples are supported */
+  if ((ir->maxval <= 0) || (ir->maxval > 255))
+  {
+    printf("Read image failed: Unsupported PPM maximum value.\n");
+    return 1;
+  }
+
+  ir->top_down = 1;
+  ir->bytes_per_pixel = 3;
+
+  return 0;
+}
+
+/*******************************************************************************
+** image_open_tga()
+*******************************************************************************/
+static short int image_open_tga(image_reader* ir, unsigned char* header)
+{
+  int image_type;
+  int color_map_type;
+  int color_map_first;
+  int color_map_entry_size;
+  int pixel_bpp;
+
+  unsigned char entry[4];
+
+  int k;
+
+  ir->format = IMAGE_FORMAT_TGA;
+
+  image_type = header[2];
+  color_map_type = header[1];
+
+  /* multi-byte fields are little endian */
+  color_map_first = header[3] | (header[4] << 8);
+  ir->color_map_length = header[5] | (header[6] << 8);
+  color_map_entry_size = header[7];
+
+  ir->width = header[12] | (header[13] << 8);
+  ir->height = header[14] | (header[15] << 8);
+
+  pixel_bpp = header[16];
+  ir->top_down = (header[17] & 0x20) ? 1 : 0;
+
+  ir->maxval = 255;
+
+  if ((ir->width <= 0) || (ir->height <= 0))
+  {
+    printf("Read image failed: Invalid TGA dimensions.\n");
+    return 1;
+  }
+
+  /* check image type & pixel size */
+  if ((image_type == 2) && ((pixel_bpp == 24) || (pixel_bpp == 32)))
+    ir->bytes_per_pixel = pixel_bpp / 8;
+  else if ((image_type == 3) && (pixel_bpp == 8))
+    ir->bytes_per_pixel = 1;
+  else if ( (image_type == 1) && (color_map_type == 1) &&
+            ((pixel_bpp == 8) || (pixel_bpp == 16)))
+  {
+    ir->bytes_per_pixel = pixel_bpp / 8;
+  }
+  else
+  {
+    printf("Read image failed: Unsupported TGA type ");
+    printf("(only uncompressed 24/32-bit, greyscale & color mapped).\n");
+    return 1;
+  }
+
+  /* skip image id field */
+  if (fseek(ir->fp, header[0], SEEK_CUR))
+  {
+    printf("Read image failed: Truncated TGA header.\n");
+    return 1;
+  }
+
+  /* skip color map (truecolor & greyscale images) */
+  if ((color_map_type == 1) && (image_type != 1))
+  {
+    if (fseek(ir->fp, ir->color_map_length * ((color_map_entry_size + 7) / 8),
+              SEEK_CUR))
+    {
+      printf("Read image failed: Truncated TGA color map.\n");
+      return 1;
+    }
+
+    ir->color_map_length = 0;
+  }
+  /* read color map (color mapped images) */
+  else if (color_map_type == 1)
+  {
+    if ((color_map_entry_size != 24) && (color_map_entry_size != 32))
+    {
+      printf("Read image failed: Unsupported TGA color map entry size.\n");
+      return 1;
+    }
+
+    ir->color_map = malloc(sizeof(color) * (color_map_first +
+                                            ir->color_map_length));
+
+    if (ir->color_map == NULL)
+    {
+      printf("Read image failed: Out of memory.\n");
+      return 1;
+    }
+
+    memset(ir->color_map, 0, sizeof(color) * color_map_first);
+
+    for (k = 0; k < ir->color_map_length; k++)
+    {
+      if (fread(entry, 1, color_map_entry_size / 8, ir->fp) <
+          (size_t) (color_map_entry_size / 8))
+      {
+        printf("Read image failed: Truncated TGA color map.\n");
+        return 1;
+      }
+
+      ir->color_map[color_map_first + k].r = entry[2];
+      ir->color_map[color_map_first + k].g = entry[1];
+      ir->color_map[color_map_first + k].b = entry[0];
+    }
+
+    /* indices are looked up from entry 0 */
+    ir->color_map_length += color_map_first;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** image_reader_open()
+*******************************************************************************/
+short int image_reader_open(image_reader* ir, char* filename)
+{
+  unsigned char header[18];
+
+  if (ir == NULL)
+    return 1;
+
+  /* initialization */
+  ir->fp = NULL;
+
+  ir->format = IMAGE_FORMAT_TGA;
+  ir->width = 0;
+  ir->height = 0;
+  ir->top_down = 1;
+
+  ir->bytes_per_pixel = 0;
+  ir->maxval = 255;
+
+  ir->color_map = NULL;
+  ir->color_map_length = 0;
+
+  ir->row_buffer = NULL;
+  ir->rows_read = 0;
+
+  /* make sure filename is valid */
+  if (filename == NULL)
+  {
+    printf("Read image failed: No filename specified.\n");
+    return 1;
+  }
+
+  /* open file */
+  ir->fp = fopen(filename, "rb");
+
+  if (ir->fp == NULL)
+  {
+    printf("Read image failed: Unable to open input file %s.\n", filename);
+    return 1;
+  }
+
+  /* ppm files start with "P6", otherwise assume tga */
+  if (fread(header, 1, 2, ir->fp) < 2)
+  {
+    printf("Read image failed: Input file is too short.\n");
+    image_reader_close(ir);
+    return 1;
+  }
+
+  if ((header[0] == 'P') && (header[1] == '6'))
+  {
+    if (image_open_ppm(ir))
+    {
+      image_reader_close(ir);
+      return 1;
+    }
+  }
+  else
+  {
+    if (fread(&header[2], 1, 16, ir->fp) < 16)
+    {
+      printf("Read image failed: Truncated TGA header.\n");
+      image_reader_close(ir);
+      return 1;
+    }
+
+    if (image_open_tga(ir, header))
+    {
+      image_reader_close(ir);
+      return 1;
+    }
+  }
+
+  /* allocate row buffer */
+  ir->row_buffer = malloc(ir->width * ir->bytes_per_pixel);
+
+  if (ir->row_buffer == NULL)
+  {
+    printf("Read image failed: Out of memory.\n");
+    image_reader_close(ir);
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** image_read_rows()
+*******************************************************************************/
+short int image_read_rows(image_reader* ir, color* pixels, int num_rows)
+{
+  unsigned char*  p;
+
+  int row;
+  int x;
+  int index;
+
+  for (row = 0; row < num_rows; row++)
+  {
+    if (ir->rows_read >= ir->height)
+    {
+      printf("Read image failed: Read past the last row.\n");
+      return 1;
+    }
+
+    if (fread(ir->row_buffer, ir->bytes_per_pixel, ir->width, ir->fp) <
+        (size_t) ir->width)
+    {
+      printf("Read image failed: Truncated pixel data.\n");
+      return 1;
+    }
+
+    p = ir->row_buffer;
+
+    /* ppm pixels are rgb, scaled by the maximum value */
+    if (ir->format == IMAGE_FORMAT_PPM)
+    {
+      for (x = 0; x < ir->width; x++, p += 3)
+      {
+        if (ir->maxval == 255)
+        {
+          pixels[x].r = p[0];
+          pixels[x].g = p[1];
+          pixels[x].b = p[2];
+        }
+        else
+        {
+          pixels[x].r = ((p[0] * 255) + (ir->maxval / 2)) / ir->maxval;
+          pixels[x].g = ((p[1] * 255) + (ir->maxval / 2)) / ir->maxval;
+          pixels[x].b = ((p[2] * 255) + (ir->maxval / 2)) / ir->maxval;
+        }
+      }
+    }
+    /* tga color mapped pixels */
+    else if (ir->color_map != NULL)
+    {
+      for (x = 0; x < ir->width; x++, p += ir->bytes_per_pixel)
+      {
+        if (ir->bytes_per_pixel == 2)
+          index = p[0] | (p[1] << 8);
+        else
+          index = p[0];
+
+        if (index < ir->color_map_length)
+          pixels[x] = ir->color_map[index];
+        else
+          pixels[x].r = pixels[x].g = pixels[x].b = 0;
+      }
+    }
+    /* tga greyscale pixels */
+    else if (ir->bytes_per_pixel == 1)
+    {
+      for (x = 0; x < ir->width; x++, p += 1)
+        pixels[x].r = pixels[x].g = pixels[x].b = p[0];
+    }
+    /* tga truecolor pixels are bgr(a) */
+    else
+    {
+      for (x = 0; x < ir->width; x++, p += ir->bytes_per_pixel)
+      {
+        pixels[x].r = p[2];
+        pixels[x].g = p[1];
+        pixels[x].b = p[0];
+      }
+    }
+
+    pixels += ir->width;
+    ir->rows_read += 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** image_reader_close()
+*******************************************************************************/
+void image_reader_close(image_reader* ir)
+{
+  if (ir == NULL)
+    return;
+
+  if (ir->fp != NULL)
+  {
+    fclose(ir->fp);
+    ir->fp = NULL;
+  }
+
+  if (ir->color_map != NULL)
+  {
+    free(ir->color_map);
+    ir->color_map = NULL;
+  }
+
+  if (ir->row_buffer != NULL)
+  {
+    free(ir->row_buffer);
+    ir->row_buffer = NULL;
+  }
+}
+
+/*******************************************************************************
+** image_writer_start()
+*******************************************************************************/
+static short int image_writer_start(image_writer* iw, char* filename,
+                                    int width, int height,
+                                    int bytes_per_pixel)
+{
+  /* initialization */
+  iw->fp = NULL;
+
+  iw->width = width;
+  iw->height = height;
+  iw->bytes_per_pixel = bytes_per_pixel;
+
+  iw->row_buffer = NULL;
+  iw->rows_written = 0;
+
+  if ((width <= 0) || (width > 65535) || (height <= 0) || (height > 65535))
+  {
+    printf("Write image failed: Invalid image dimensions.\n");
+    return 1;
+  }
+
+  /* make sure filename is valid */
+  if (filename == NULL)
+  {
+    printf("Write image failed: No filename specified.\n");
+    return 1;
+  }
+
+  /* open file */
+  iw->fp = fopen(filename, "wb");
+
+  if (iw->fp == NULL)
+  {
+    printf("Write image failed: Unable to open output file %s.\n", filename);
+    return 1;
+  }
+
+  iw->row_buffer = malloc(width * bytes_per_pixel);
+
+  if (iw->row_buffer == NULL)
+  {
+    printf("Write image failed: Out of memory.\n");
+    image_writer_close(iw);
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** image_writer_header()
+*******************************************************************************/
+static void image_writer_header(image_writer* iw, unsigned char* header,
+                                int image_type, int num_colors, int top_down)
+{
+  /* header (multi-byte fields are little endian) */
+  header[0] = 0;                          /* image id field length  */
+  header[1] = (num_colors > 0) ? 1 : 0;   /* color map type         */
+  header[2] = image_type;                 /* image type             */
+  header[3] = 0;                          /* color map first entry  */
+  header[4] = 0;
+  header[5] = num_colors & 0xFF;          /* color map length       */
+  header[6] = (num_colors >> 8) & 0xFF;
+  header[7] = (num_colors > 0) ? 24 : 0;  /* color map entry size   */
+  header[8] = 0;                          /* x origin               */
+  header[9] = 0;
+  header[10] = 0;                         /* y origin               */
+  header[11] = 0;
+  header[12] = iw->width & 0xFF;          /* image width            */
+  header[13] = (iw->width >> 8) & 0xFF;
+  header[14] = iw->height & 0xFF;         /* image height           */
+  header[15] = (iw->height >> 8) & 0xFF;
+  header[16] = 8 * iw->bytes_per_pixel;   /* pixel bpp              */
+  header[17] = top_down ? 0x20 : 0x00;    /* image descriptor       */
+}
+
+/*******************************************************************************
+** image_writer_open_indexed()
+*******************************************************************************/
+short int image_writer_open_indexed(image_writer* iw, char* filename,
+                                    int width, int height, int top_down,
+                                    color* palette, int num_colors)
+{
+  unsigned char header[18];
+  unsigned char entry[3];
+
+  int k;
+
+  if (iw == NULL)
+    return 1;
+
+  iw->fp = NULL;
+  iw->row_buffer = NULL;
+
+  /* the tga color map length is a 16-bit field */
+  if ((num_colors <= 0) || (num_colors > 65535))
+  {
+    printf("Write image failed: Indexed output needs 1 to 65535 colors.\n");
+    return 1;
+  }
+
+  if (image_writer_start(iw, filename, width, height,
+                         (num_colors <= 256) ? 1 : 2))
+  {
+    return 1;
+  }
+
+  image_writer_header(iw, header, 1, num_colors, top_down);
+
+  if (fwrite(header, 1, 18, iw->fp) < 18)
+  {
+    printf("Write image failed: Unable to write header.\n");
+    image_writer_close(iw);
+    return 1;
+  }
+
+  /* color map */
+  for (k = 0; k < num_colors; k++)
+  {
+    entry[2] = palette[k].r;
+    entry[1] = palette[k].g;
+    entry[0] = palette[k].b;
+
+    if (fwrite(entry, 1, 3, iw->fp) < 3)
+    {
+      printf("Write image failed: Unable to write color map.\n");
+      image_writer_close(iw);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** image_writer_open_rgb()
+*******************************************************************************/
+short int image_writer_open_rgb(image_writer* iw, char* filename,
+                                int width, int height, int top_down)
+{
+  unsigned char header[18];
+
+  if (iw == NULL)
+    return 1;
+
+  if (image_writer_start(iw, filename, width, height, 3))
+    return 1;
+
+  image_writer_header(iw, header, 2, 0, top_down);
+
+  if (fwrite(header, 1, 18, iw->fp) < 18)
+  {
+    printf("Write image failed: Unable to write header.\n");
+    image_writer_close(iw);
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** image_write_index_rows()
+*******************************************************************************/
+short int image_write_index_rows(image_writer* iw, int* indices, int num_rows)
+{
+  int row;
+  int x;
+
+  for (row = 0; row < num_rows; row++)
+  {
+    if (iw->rows_written >= iw->height)
+    {
+      printf("Write image failed: Wrote past the last row.\n");
+      return 1;
+    }
+
+    /* indices are 8-bit, or 16-bit little endian */
+    if (iw->bytes_per_pixel == 1)
+    {
+      for (x = 0; x < iw->width; x++)
+        iw->row_buffer[x] = indices[x];
+    }
+    else
+    {
+      for (x = 0; x < iw->width; x++)
+      {
+        iw->row_buffer[2 * x] = indices[x] & 0xFF;
+        iw->row_buffer[2 * x + 1] = (indices[x] >> 8) & 0xFF;
+      }
+    }
+
+    if (fwrite(iw->row_buffer, iw->bytes_per_pixel, iw->width, iw->fp) <
+        (size_t) iw->width)
+    {
+      printf("Write image failed: Unable to write pixel data.\n");
+      return 1;
+    }
+
+    indices += iw->width;
+    iw->rows_written += 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** image_write_rows()
+*******************************************************************************/
+short int image_write_rows(image_writer* iw, color* pixels, int num_rows)
+{
+  int row;
+  int x;
+
+  for (row = 0; row < num_rows; row++)
+  {
+    if (iw->rows_written >= iw->height)
+    {
+      printf("Write image failed: Wrote past the last row.\n");
+      return 1;
+    }
+
+    /* tga pixels are stored as bgr */
+    for (x = 0; x < iw->width; x++)
+    {
+      iw->row_buffer[3 * x] = pixels[x].b;
+      iw->row_buffer[3 * x + 1] = pixels[x].g;
+      iw->row_buffer[3 * x + 2] = pixels[x].r;
+    }
+
+    if (fwrite(iw->row_buffer, 3, iw->width, iw->fp) < (size_t) iw->width)
+    {
+      printf("Write image failed: Unable to write pixel data.\n");
+      return 1;
+    }
+
+    pixels += iw->width;
+    iw->rows_written += 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** image_writer_close()
+*******************************************************************************/
+short int image_writer_close(image_writer* iw)
+{
+  short int status;
+
+  if (iw == NULL)
+    return 1;
+
+  status = 0;
+
+  if (iw->fp != NULL)
+  {
+    if (fclose(iw->fp))
+      status = 1;
+
+    iw->fp = NULL;
+  }
+
+  if (iw->row_buffer != NULL)
+  {
+    free(iw->row_buffer);
+    iw->row_buffer = NULL;
+  }
+
+  return status;
+}
@@ -0,0 +1,71 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** image.h (streaming image input & output)
+*******************************************************************************/
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdio.h>
+
+#include "palette.h"
+
+enum
+{
+  IMAGE_FORMAT_TGA = 0,
+  IMAGE_FORMAT_PPM
+};
+
+/* images are read & written one row at a time, in the  */
+/* order the rows are stored in the file, so that large */
+/* images never have to be held in memory all at once   */
+typedef struct image_reader
+{
+  FILE*           fp;
+
+  int             format;
+  int             width;
+  int             height;
+  int             top_down;
+
+  int             bytes_per_pixel;
+  int             maxval;
+
+  color*          color_map;
+  int             color_map_length;
+
+  unsigned char*  row_buffer;
+  int             rows_read;
+} image_reader;
+
+typedef struct image_writer
+{
+  FILE*           fp;
+
+  int             width;
+  int             height;
+  int             bytes_per_pixel;
+
+  unsigned char*  row_buffer;
+  int             rows_written;
+} image_writer;
+
+/* function declarations */
+short int image_reader_open(image_reader* ir, char* filename);
+short int image_read_rows(image_reader* ir, color* pixels, int num_rows);
+void      image_reader_close(image_reader* ir);
+
+short int image_writer_open_indexed(image_writer* iw, char* filename,
+                                    int width, int height, int top_down,
+                                    color* palette, int num_colors);
+short int image_write_index_rows(image_writer* iw, int* indices, int num_rows);
+
+short int image_writer_open_rgb(image_writer* iw, char* filename,
+                                int width, int height, int top_down);
+short int image_write_rows(image_writer* iw, color* pixels, int num_rows);
+short int image_writer_close(image_writer* iw);
+
+#endif
@@ -0,0 +1,1183 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** inverse.c (rgb to palette index tables)
+*******************************************************************************/
+
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L
+#define INVERSE_HAVE_POSIX
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define INVERSE_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(INVERSE_HAVE_POSIX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include "inverse.h"
+#include "output.h"
+#include "palette.h"
+#include "parallel.h"
+
+/* the full table is built with a distance transform: every     */
+/* palette color is placed in a 256^3 grid, and the squared     */
+/* distance to (and index of) the nearest placed color is then  */
+/* spread along b, g & r in turn; each pass is a lower envelope */
+/* of parabolas along every line of the grid, so the whole      */
+/* build is linear in the size of the grid, however large the   */
+/* palette is (the lines of a pass are independent, & are split */
+/* across threads a plane at a time)                            */
+
+/* colors at the same distance (ties) give the lowest index, */
+/* the same as a linear search (each pass keeps the lowest   */
+/* index of the colors tied at each point)                   */
+
+/* the smaller tables can also be filled by comparing each entry */
+/* against every palette color (4 entries at a time with sse2),  */
+/* which gives the lowest index of the nearest colors, the same  */
+/* as a linear search; the entries are split into jobs of this   */
+/* many entries                                                  */
+#define INVERSE_SEARCH_JOB_ENTRIES 4096
+#define INVERSE_SIZE      256
+#define INVERSE_INFINITY  0x7FFFFFFF
+
+/* the g & r lines are spread out in memory, so they are copied */
+/* out & back this many at a time (a cache line from each row)  */
+#define INVERSE_CHUNK     16
+
+#define INVERSE_MAGIC         "PALINV01"
+#define INVERSE_MAGIC_LENGTH  8
+
+/* entries are written in the byte order of the machine, */
+/* which is recorded by writing this value as is         */
+#define INVERSE_BYTE_ORDER    0x01020304UL
+
+enum
+{
+  INVERSE_PASS_B = 0,
+  INVERSE_PASS_G,
+  INVERSE_PASS_R,
+  INVERSE_PASS_PACK
+};
+
+typedef struct inverse_build
+{
+  inverse_table*  it;
+
+  int*            dist;
+  int*            label;
+
+  int             pass;
+} inverse_build;
+
+typedef struct inverse_search
+{
+  inverse_table*  it;
+
+  /* palette colors, packed as 16-bit pairs (r & g, then b & 0) */
+  int*            rg;
+  int*            b;
+  int             num_colors;
+
+  int             levels[3][INVERSE_SIZE];
+} inverse_search;
+
+/* format names (used for the command line), file extensions & bits */
+static char* S_inverse_format_names[INVERSE_NUM_FORMATS] =
+  { "888",
+    "555",
+    "565"
+  };
+
+static char* S_inverse_format_extensions[INVERSE_NUM_FORMATS] =
+  { ".888.inv",
+    ".555.inv",
+    ".565.inv"
+  };
+
+static char* S_inverse_c_extensions[INVERSE_NUM_FORMATS] =
+  { ".888.h",
+    ".555.h",
+    ".565.h"
+  };
+
+static int S_inverse_format_bits[INVERSE_NUM_FORMATS][3] =
+  { {8, 8, 8},
+    {5, 5, 5},
+    {5, 6, 5}
+  };
+
+/*******************************************************************************
+** inverse_format_from_name()
+*******************************************************************************/
+int inverse_format_from_name(char* name)
+{
+  int k;
+
+  if (name == NULL)
+    return -1;
+
+  for (k = 0; k < INVERSE_NUM_FORMATS; k++)
+  {
+    if (!strcmp(S_inverse_format_names[k], name))
+      return k;
+  }
+
+  return -1;
+}
+
+/*******************************************************************************
+** inverse_format_extension()
+*******************************************************************************/
+char* inverse_format_extension(int format)
+{
+  if ((format < 0) || (format >= INVERSE_NUM_FORMATS))
+    return NULL;
+
+  return S_inverse_format_extensions[format];
+}
+
+/*******************************************************************************
+** inverse_c_extension()
+*******************************************************************************/
+char* inverse_c_extension(int format)
+{
+  if ((format < 0) || (format >= INVERSE_NUM_FORMATS))
+    return NULL;
+
+  return S_inverse_c_extensions[format];
+}
+
+/*******************************************************************************
+** inverse_write_field()
+*******************************************************************************/
+static void inverse_write_field(unsigned char* p, unsigned long value)
+{
+  /* header fields are 32-bit little endian */
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = (value >> 24) & 0xFF;
+}
+
+/*******************************************************************************
+** inverse_read_field()
+*******************************************************************************/
+static unsigned long inverse_read_field(unsigned char* p)
+{
+  return  ((unsigned long) p[0])        | ((unsigned long) p[1] << 8) |
+          ((unsigned long) p[2] << 16)  | ((unsigned long) p[3] << 24);
+}
+
+/*******************************************************************************
+** inverse_table_alloc()
+*******************************************************************************/
+static short int inverse_table_alloc(inverse_table* it, int format,
+                                     int num_colors)
+{
+  unsigned int  order;
+  unsigned char* header;
+
+  it->format = format;
+
+  it->r_bits = S_inverse_format_bits[format][0];
+  it->g_bits = S_inverse_format_bits[format][1];
+  it->b_bits = S_inverse_format_bits[format][2];
+
+  it->num_colors = num_colors;
+  it->num_entries = 1L << (it->r_bits + it->g_bits + it->b_bits);
+
+  if (num_colors <= 256)
+    it->bytes_per_entry = 1;
+  else if (num_colors <= 65536)
+    it->bytes_per_entry = 2;
+  else
+    it->bytes_per_entry = 4;
+
+  it->num_bytes = INVERSE_HEADER_SIZE + it->num_entries * it->bytes_per_entry;
+  it->mapped = 0;
+
+  it->data = malloc(it->num_bytes);
+
+  if (it->data == NULL)
+  {
+    printf("Inverse table failed: Out of memory.\n");
+    it->entries = NULL;
+    return 1;
+  }
+
+  it->entries = it->data + INVERSE_HEADER_SIZE;
+
+  /* header */
+  header = it->data;
+
+  memset(header, 0, INVERSE_HEADER_SIZE);
+  memcpy(header, INVERSE_MAGIC, INVERSE_MAGIC_LENGTH);
+
+  header[8] = it->r_bits;
+  header[9] = it->g_bits;
+  header[10] = it->b_bits;
+  header[11] = it->bytes_per_entry;
+
+  inverse_write_field(&header[12], num_colors);
+  inverse_write_field(&header[20], INVERSE_HEADER_SIZE);
+
+  order = (unsigned int) INVERSE_BYTE_ORDER;
+  memcpy(&header[16], &order, 4);
+
+  return 0;
+}
+
+/*******************************************************************************
+** inverse_set_entry()
+*******************************************************************************/
+static void inverse_set_entry(inverse_table* it, long k, int index)
+{
+  if (it->bytes_per_entry == 1)
+    it->entries[k] = (unsigned char) index;
+  else if (it->bytes_per_entry == 2)
+    ((unsigned short*) it->entries)[k] = (unsigned short) index;
+  else
+    ((unsigned int*) it->entries)[k] = (unsigned int) index;
+}
+
+/*******************************************************************************
+** inverse_table_lookup()
+*******************************************************************************/
+int inverse_table_lookup(inverse_table* it, int r, int g, int b)
+{
+  long k;
+
+  k = ((long) (r >> (8 - it->r_bits)) << (it->g_bits + it->b_bits)) |
+      ((g >> (8 - it->g_bits)) << it->b_bits) |
+      (b >> (8 - it->b_bits));
+
+  if (it->bytes_per_entry == 1)
+    return it->entries[k];
+  else if (it->bytes_per_entry == 2)
+    return ((unsigned short*) it->entries)[k];
+
+  return (int) ((unsigned int*) it->entries)[k];
+}
+
+/*******************************************************************************
+** inverse_transform_line()
+*******************************************************************************/
+static void inverse_transform_line(int* dist, int* label, long stride)
+{
+  int   f[INVERSE_SIZE];
+  int   l[INVERSE_SIZE];
+  int   v[INVERSE_SIZE];
+
+  long  n0;
+  long  n1;
+
+  int   num;
+  int   best;
+  int   best_label;
+  int   next;
+  int   j;
+  int   p;
+  int   q;
+  int   k;
+  int   x;
+
+  /* gather the line */
+  for (x = 0; x < INVERSE_SIZE; x++)
+  {
+    f[x] = dist[x * stride];
+    l[x] = label[x * stride];
+  }
+
+  /* lower envelope of the parabolas f[q] + (x - q)^2; the   */
+  /* parabola at q takes over from the one at v[k] at        */
+  /* ((f[q] + q^2) - (f[v[k]] + v[k]^2)) / 2(q - v[k]), and  */
+  /* parabolas whose range ends before it starts are dropped */
+  /* (the ranges are compared as exact fractions, & a range  */
+  /* of a single point is kept, since it may be a tie)       */
+  num = 0;
+
+  for (q = 0; q < INVERSE_SIZE; q++)
+  {
+    if (f[q] == INVERSE_INFINITY)
+      continue;
+
+    while (num >= 2)
+    {
+      k = v[num - 1];
+      p = v[num - 2];
+
+      n1 = ((long) f[q] + (long) q * q) - ((long) f[k] + (long) k * k);
+      n0 = ((long) f[k] + (long) k * k) - ((long) f[p] + (long) p * p);
+
+      if (n1 * (k - p) >= n0 * (q - k))
+        break;
+
+      num -= 1;
+    }
+
+    v[num] = q;
+    num += 1;
+  }
+
+  /* no colors on this line yet */
+  if (num == 0)
+    return;
+
+  /* take the lowest parabola at each point (moving on */
+  /* to the next one only once it is strictly lower)   */
+  k = 0;
+
+  for (x = 0; x < INVERSE_SIZE; x++)
+  {
+    best = f[v[k]] + (x - v[k]) * (x - v[k]);
+
+    while (k + 1 < num)
+    {
+      next = f[v[k + 1]] + (x - v[k + 1]) * (x - v[k + 1]);
+
+      if (next >= best)
+        break;
+
+      best = next;
+      k += 1;
+    }
+
+    /* any ties come right after it; the lowest label wins, */
+    /* so the table gives the lowest index of the nearest   */
+    /* colors (as a linear search does)                     */
+    best_label = l[v[k]];
+
+    for (j = k + 1; j < num; j++)
+    {
+      next = f[v[j]] + (x - v[j]) * (x - v[j]);
+
+      if (next != best)
+        break;
+
+      if (l[v[j]] < best_label)
+        best_label = l[v[j]];
+    }
+
+    dist[x * stride] = best;
+    label[x * stride] = best_label;
+  }
+}
+
+/*******************************************************************************
+** inverse_transform_chunk()
+*******************************************************************************/
+static void inverse_transform_chunk(inverse_build* ib, long base, long stride)
+{
+  int   f[INVERSE_CHUNK][INVERSE_SIZE];
+  int   l[INVERSE_CHUNK][INVERSE_SIZE];
+
+  long  k;
+  int   x;
+  int   j;
+
+  /* copy out the lines (next to each other in memory) */
+  for (x = 0; x < INVERSE_SIZE; x++)
+  {
+    k = base + x * stride;
+
+    for (j = 0; j < INVERSE_CHUNK; j++)
+    {
+      f[j][x] = ib->dist[k + j];
+      l[j][x] = ib->label[k + j];
+    }
+  }
+
+  for (j = 0; j < INVERSE_CHUNK; j++)
+    inverse_transform_line(f[j], l[j], 1);
+
+  /* copy them back */
+  for (x = 0; x < INVERSE_SIZE; x++)
+  {
+    k = base + x * stride;
+
+    for (j = 0; j < INVERSE_CHUNK; j++)
+    {
+      ib->dist[k + j] = f[j][x];
+      ib->label[k + j] = l[j][x];
+    }
+  }
+}
+
+/*******************************************************************************
+** inverse_build_plane()
+*******************************************************************************/
+static void inverse_build_plane(void* data, int plane)
+{
+  inverse_build*  ib;
+
+  long  base;
+  long  k;
+  int   x;
+
+  ib = (inverse_build*) data;
+
+  /* the b & g passes work on the lines of an r plane, */
+  /* and the r pass on the lines of a g plane           */
+  if (ib->pass == INVERSE_PASS_B)
+  {
+    base = (long) plane * INVERSE_SIZE * INVERSE_SIZE;
+
+    for (x = 0; x < INVERSE_SIZE; x++)
+    {
+      k = base + (long) x * INVERSE_SIZE;
+      inverse_transform_line(&ib->dist[k], &ib->label[k], 1);
+    }
+  }
+  else if (ib->pass == INVERSE_PASS_G)
+  {
+    base = (long) plane * INVERSE_SIZE * INVERSE_SIZE;
+
+    for (x = 0; x < INVERSE_SIZE; x += INVERSE_CHUNK)
+      inverse_transform_chunk(ib, base + x, INVERSE_SIZE);
+  }
+  else if (ib->pass == INVERSE_PASS_R)
+  {
+    base = (long) plane * INVERSE_SIZE;
+
+    for (x = 0; x < INVERSE_SIZE; x += INVERSE_CHUNK)
+      inverse_transform_chunk(ib, base + x, (long) INVERSE_SIZE * INVERSE_SIZE);
+  }
+  else
+  {
+    /* pack the indices of an r plane into the table */
+    base = (long) plane * INVERSE_SIZE * INVERSE_SIZE;
+
+    for (k = base; k < base + INVERSE_SIZE * INVERSE_SIZE; k++)
+      inverse_set_entry(ib->it, k, ib->label[k]);
+  }
+}
+
+/*******************************************************************************
+** inverse_table_build()
+*******************************************************************************/
+short int inverse_table_build(inverse_table* it, color* colors,
+                              int num_colors)
+{
+  inverse_build ib;
+
+  long  num_entries;
+  long  k;
+  int   n;
+
+  if (it == NULL)
+    return 1;
+
+  it->data = NULL;
+  it->entries = NULL;
+
+  if ((colors == NULL) || (num_colors <= 0))
+  {
+    printf("Inverse table failed: The palette is empty.\n");
+    return 1;
+  }
+
+  if (inverse_table_alloc(it, INVERSE_FORMAT_888, num_colors))
+    return 1;
+
+  num_entries = it->num_entries;
+
+  ib.it = it;
+  ib.dist = malloc(sizeof(int) * num_entries);
+  ib.label = malloc(sizeof(int) * num_entries);
+
+  if ((ib.dist == NULL) || (ib.label == NULL))
+  {
+    printf("Inverse table failed: Out of memory.\n");
+    free(ib.dist);
+    free(ib.label);
+    inverse_table_deinit(it);
+    return 1;
+  }
+
+  /* place the palette colors (the first of any repeats wins) */
+  for (k = 0; k < num_entries; k++)
+  {
+    ib.dist[k] = INVERSE_INFINITY;
+    ib.label[k] = -1;
+  }
+
+  for (n = 0; n < num_colors; n++)
+  {
+    k = ((long) colors[n].r << 16) | (colors[n].g << 8) | colors[n].b;
+
+    if (ib.label[k] < 0)
+    {
+      ib.dist[k] = 0;
+      ib.label[k] = n;
+    }
+  }
+
+  /* spread along each axis in turn (each pass needs the last one done) */
+  for (ib.pass = INVERSE_PASS_B; ib.pass <= INVERSE_PASS_PACK; ib.pass++)
+  {
+    if (parallel_run(INVERSE_SIZE, inverse_build_plane, &ib))
+    {
+      free(ib.dist);
+      free(ib.label);
+      inverse_table_deinit(it);
+      return 1;
+    }
+  }
+
+  free(ib.dist);
+  free(ib.label);
+
+  return 0;
+}
+
+/*******************************************************************************
+** inverse_levels()
+*******************************************************************************/
+static void inverse_levels(inverse_table* it, int levels[3][INVERSE_SIZE])
+{
+  int bits[3];
+  int c;
+  int n;
+
+  bits[0] = it->r_bits;
+  bits[1] = it->g_bits;
+  bits[2] = it->b_bits;
+
+  /* each reduced value stands for the 8-bit value with its */
+  /* bits repeated (so that 0 is 0, and the top is 255)     */
+  for (c = 0; c < 3; c++)
+  {
+    for (n = 0; n < (1 << bits[c]); n++)
+    {
+      levels[c][n] = n << (8 - bits[c]);
+      levels[c][n] |= levels[c][n] >> bits[c];
+    }
+  }
+}
+
+/*******************************************************************************
+** inverse_table_reduce()
+*******************************************************************************/
+short int inverse_table_reduce(inverse_table* it, inverse_table* full,
+                               int format)
+{
+  int   levels[3][INVERSE_SIZE];
+
+  long  k;
+  int   r;
+  int   g;
+  int   b;
+
+  if ((it == NULL) || (full == NULL))
+    return 1;
+
+  it->data = NULL;
+  it->entries = NULL;
+
+  if ((format < 0) || (format >= INVERSE_NUM_FORMATS) ||
+      (full->format != INVERSE_FORMAT_888))
+  {
+    printf("Inverse table failed: Invalid table format.\n");
+    return 1;
+  }
+
+  if (inverse_table_alloc(it, format, full->num_colors))
+    return 1;
+
+  inverse_levels(it, levels);
+
+  /* sample the full table at the values the entries stand for */
+  k = 0;
+
+  for (r = 0; r < (1 << it->r_bits); r++)
+  {
+    for (g = 0; g < (1 << it->g_bits); g++)
+    {
+      for (b = 0; b < (1 << it->b_bits); b++)
+      {
+        inverse_set_entry(it, k, inverse_table_lookup(full, levels[0][r],
+                                                            levels[1][g],
+                                                            levels[2][b]));
+        k += 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** inverse_search_entry()
+*******************************************************************************/
+static void inverse_search_entry(inverse_search* is, long k, int* rg, int* b)
+{
+  inverse_table* it;
+
+  int r_value;
+  int g_value;
+  int b_value;
+
+  it = is->it;
+
+  r_value = is->levels[0][k >> (it->g_bits + it->b_bits)];
+  g_value = is->levels[1][(k >> it->b_bits) & ((1 << it->g_bits) - 1)];
+  b_value = is->levels[2][k & ((1 << it->b_bits) - 1)];
+
+  *rg = r_value | (g_value << 16);
+  *b = b_value;
+}
+
+/*******************************************************************************
+** inverse_search_scalar()
+*******************************************************************************/
+static void inverse_search_scalar(inverse_search* is, long start, long end)
+{
+  long  k;
+  int   n;
+
+  int   rg;
+  int   b;
+
+  int   dr;
+  int   dg;
+  int   db;
+
+  int   dist;
+  int   best_dist;
+  int   best;
+
+  for (k = start; k < end; k++)
+  {
+    inverse_search_entry(is, k, &rg, &b);
+
+    best = 0;
+    best_dist = INVERSE_INFINITY;
+
+    for (n = 0; n < is->num_colors; n++)
+    {
+      dr = (rg & 0xFFFF) - (is->rg[n] & 0xFFFF);
+      dg = (rg >> 16) - (is->rg[n] >> 16);
+      db = b - is->b[n];
+
+      dist = (dr * dr) + (dg * dg) + (db * db);
+
+      if (dist < best_dist)
+      {
+        best_dist = dist;
+        best = n;
+      }
+    }
+
+    inverse_set_entry(is->it, k, best);
+  }
+}
+
+#if defined(INVERSE_HAVE_SSE2)
+/*******************************************************************************
+** inverse_search_sse2()
+*******************************************************************************/
+static long inverse_search_sse2(inverse_search* is, long start, long end)
+{
+  __m128i target_rg;
+  __m128i target_b;
+  __m128i d;
+  __m128i dist;
+  __m128i mask;
+  __m128i best_dist;
+  __m128i best;
+
+  int     rg[4];
+  int     b[4];
+  int     indices[4];
+
+  long    k;
+  int     n;
+  int     j;
+
+  for (k = start; k + 4 <= end; k += 4)
+  {
+    for (j = 0; j < 4; j++)
+      inverse_search_entry(is, k + j, &rg[j], &b[j]);
+
+    target_rg = _mm_setr_epi32(rg[0], rg[1], rg[2], rg[3]);
+    target_b = _mm_setr_epi32(b[0], b[1], b[2], b[3]);
+
+    best_dist = _mm_set1_epi32(INVERSE_INFINITY);
+    best = _mm_setzero_si128();
+
+    /* the differences are 16-bit pairs, so one multiply-add */
+    /* gives dr^2 + dg^2 (and the other db^2 + 0)            */
+    for (n = 0; n < is->num_colors; n++)
+    {
+      d = _mm_sub_epi16(target_rg, _mm_set1_epi32(is->rg[n]));
+      dist = _mm_madd_epi16(d, d);
+
+      d = _mm_sub_epi16(target_b, _mm_set1_epi32(is->b[n]));
+      dist = _mm_add_epi32(dist, _mm_madd_epi16(d, d));
+
+      /* keep the first of the nearest colors */
+      mask = _mm_cmplt_epi32(dist, best_dist);
+
+      best_dist = _mm_or_si128( _mm_and_si128(mask, dist),
+                                _mm_andnot_si128(mask, best_dist));
+      best = _mm_or_si128(_mm_and_si128(mask, _mm_set1_epi32(n)),
+                          _mm_andnot_si128(mask, best));
+    }
+
+    _mm_storeu_si128((__m128i*) indices, best);
+
+    for (j = 0; j < 4; j++)
+      inverse_set_entry(is->it, k + j, indices[j]);
+  }
+
+  return k;
+}
+#endif
+
+/*******************************************************************************
+** inverse_search_job()
+*******************************************************************************/
+static void inverse_search_job(void* data, int index)
+{
+  inverse_search* is;
+
+  long start;
+  long end;
+
+  is = (inverse_search*) data;
+
+  start = (long) index * INVERSE_SEARCH_JOB_ENTRIES;
+  end = start + INVERSE_SEARCH_JOB_ENTRIES;
+
+  if (end > is->it->num_entries)
+    end = is->it->num_entries;
+
+#if defined(INVERSE_HAVE_SSE2)
+  start = inverse_search_sse2(is, start, end);
+#endif
+
+  /* search remaining entries */
+  inverse_search_scalar(is, start, end);
+}
+
+/*******************************************************************************
+** inverse_table_search()
+*******************************************************************************/
+short int inverse_table_search(inverse_table* it, color* colors,
+                               int num_colors, int format)
+{
+  inverse_search is;
+
+  int num_jobs;
+  int n;
+
+  if (it == NULL)
+    return 1;
+
+  it->data = NULL;
+  it->entries = NULL;
+
+  if ((colors == NULL) || (num_colors <= 0))
+  {
+    printf("Inverse table failed: The palette is empty.\n");
+    return 1;
+  }
+
+  if ((format < 0) || (format >= INVERSE_NUM_FORMATS))
+  {
+    printf("Inverse table failed: Invalid table format.\n");
+    return 1;
+  }
+
+  if (inverse_table_alloc(it, format, num_colors))
+    return 1;
+
+  is.it = it;
+  is.num_colors = num_colors;
+
+  is.rg = malloc(sizeof(int) * num_colors);
+  is.b = malloc(sizeof(int) * num_colors);
+
+  if ((is.rg == NULL) || (is.b == NULL))
+  {
+    printf("Inverse table failed: Out of memory.\n");
+    free(is.rg);
+    free(is.b);
+    inverse_table_deinit(it);
+    return 1;
+  }
+
+  for (n = 0; n < num_colors; n++)
+  {
+    is.rg[n] = colors[n].r | (colors[n].g << 16);
+    is.b[n] = colors[n].b;
+  }
+
+  inverse_levels(it, is.levels);
+
+  num_jobs =  (int) ((it->num_entries + INVERSE_SEARCH_JOB_ENTRIES - 1) /
+                     INVERSE_SEARCH_JOB_ENTRIES);
+
+  if (parallel_run(num_jobs, inverse_search_job, &is))
+  {
+    free(is.rg);
+    free(is.b);
+    inverse_table_deinit(it);
+    return 1;
+  }
+
+  free(is.rg);
+  free(is.b);
+
+  return 0;
+}
+
+/*******************************************************************************
+** inverse_table_open()
+*******************************************************************************/
+short int inverse_table_open(inverse_table* it, char* filename)
+{
+  FILE*           fp;
+  unsigned char   header[INVERSE_HEADER_SIZE];
+  unsigned int    order;
+
+  int             format;
+  long            offset;
+
+#if defined(INVERSE_HAVE_POSIX)
+  struct stat     st;
+
+  void*           mapped;
+  int             fd;
+#endif
+
+  if (it == NULL)
+    return 1;
+
+  it->data = NULL;
+  it->entries = NULL;
+  it->mapped = 0;
+
+  if (filename == NULL)
+  {
+    printf("Read inverse table failed: No filename specified.\n");
+    return 1;
+  }
+
+  /* read & check the header */
+  fp = fopen(filename, "rb");
+
+  if (fp == NULL)
+  {
+    printf("Read inverse table failed: Unable to open file %s.\n", filename);
+    return 1;
+  }
+
+  if (fread(header, 1, INVERSE_HEADER_SIZE, fp) < INVERSE_HEADER_SIZE)
+  {
+    printf("Read inverse table failed: Unable to read header.\n");
+    fclose(fp);
+    return 1;
+  }
+
+  memcpy(&order, &header[16], 4);
+
+  if (memcmp(header, INVERSE_MAGIC, INVERSE_MAGIC_LENGTH))
+  {
+    printf("Read inverse table failed: Not an inverse table.\n");
+    fclose(fp);
+    return 1;
+  }
+
+  if (order != (unsigned int) INVERSE_BYTE_ORDER)
+  {
+    printf("Read inverse table failed: Written with another byte order.\n");
+    fclose(fp);
+    return 1;
+  }
+
+  for (format = 0; format < INVERSE_NUM_FORMATS; format++)
+  {
+    if ((header[8] == S_inverse_format_bits[format][0]) &&
+        (header[9] == S_inverse_format_bits[format][1]) &&
+        (header[10] == S_inverse_format_bits[format][2]))
+    {
+      break;
+    }
+  }
+
+  offset = (long) inverse_read_field(&header[20]);
+
+  if ((format == INVERSE_NUM_FORMATS) ||
+      ((header[11] != 1) && (header[11] != 2) && (header[11] != 4)) ||
+      (offset != INVERSE_HEADER_SIZE))
+  {
+    printf("Read inverse table failed: Unsupported table format.\n");
+    fclose(fp);
+    return 1;
+  }
+
+  it->format = format;
+
+  it->r_bits = header[8];
+  it->g_bits = header[9];
+  it->b_bits = header[10];
+
+  it->bytes_per_entry = header[11];
+  it->num_colors = (int) inverse_read_field(&header[12]);
+  it->num_entries = 1L << (it->r_bits + it->g_bits + it->b_bits);
+
+  it->num_bytes = INVERSE_HEADER_SIZE + it->num_entries * it->bytes_per_entry;
+
+#if defined(INVERSE_HAVE_POSIX)
+  /* map the file (read-only, so that every process shares the pages) */
+  fd = open(filename, O_RDONLY);
+
+  if (fd >= 0)
+  {
+    /* a short file would fault when the missing entries are read */
+    if (fstat(fd, &st) || (st.st_size < (off_t) it->num_bytes))
+    {
+      printf("Read inverse table failed: File is too short.\n");
+      close(fd);
+      fclose(fp);
+      return 1;
+    }
+
+    mapped = mmap(NULL, it->num_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapped != MAP_FAILED)
+    {
+      fclose(fp);
+
+      it->data = (unsigned char*) mapped;
+      it->entries = it->data + INVERSE_HEADER_SIZE;
+      it->mapped = 1;
+
+      return 0;
+    }
+  }
+#endif
+
+  /* otherwise, read the whole file */
+  it->data = malloc(it->num_bytes);
+
+  if (it->data == NULL)
+  {
+    printf("Read inverse table failed: Out of memory.\n");
+    fclose(fp);
+    return 1;
+  }
+
+  memcpy(it->data, header, INVERSE_HEADER_SIZE);
+
+  if (fread(it->data + INVERSE_HEADER_SIZE, it->bytes_per_entry,
+            it->num_entries, fp) < (size_t) it->num_entries)
+  {
+    printf("Read inverse table failed: Unable to read entries.\n");
+    fclose(fp);
+    inverse_table_deinit(it);
+    return 1;
+  }
+
+  fclose(fp);
+
+  it->entries = it->data + INVERSE_HEADER_SIZE;
+
+  return 0;
+}
+
+/*******************************************************************************
+** inverse_table_deinit()
+*******************************************************************************/
+void inverse_table_deinit(inverse_table* it)
+{
+  if ((it == NULL) || (it->data == NULL))
+    return;
+
+#if defined(INVERSE_HAVE_POSIX)
+  if (it->mapped)
+    munmap(it->data, it->num_bytes);
+  else
+    free(it->data);
+#else
+  free(it->data);
+#endif
+
+  it->data = NULL;
+  it->entries = NULL;
+  it->mapped = 0;
+}
+
+/*******************************************************************************
+** write_inverse_file()
+*******************************************************************************/
+short int write_inverse_file(inverse_table* it, char* filename)
+{
+  /* make sure filename is valid */
+  if (filename == NULL)
+  {
+    printf("Write inverse table failed: No filename specified.\n");
+    return 1;
+  }
+
+  /* the table is kept in memory as the file image */
+  if (replace_output_file(filename, (char*) it->data, it->num_bytes))
+  {
+    printf("Write inverse table failed: Unable to write table.\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_inverse_c_file()
+*******************************************************************************/
+short int write_inverse_c_file(inverse_table* it, char* name, char* filename)
+{
+  char  upper_name[PALETTE_NAME_LENGTH];
+  char* digits;
+  char* type;
+  char* buffer;
+  char* p;
+
+  unsigned long value;
+
+  long  k;
+  int   num_digits;
+  int   per_line;
+  int   j;
+
+  /* make sure filename is valid */
+  if (filename == NULL)
+  {
+    printf("Write inverse C header failed: No filename specified.\n");
+    return 1;
+  }
+
+  /* the include guard & defines use the upper case name */
+  for (j = 0; (name[j] != '\0') && (j < PALETTE_NAME_LENGTH - 1); j++)
+  {
+    if ((name[j] >= 'a') && (name[j] <= 'z'))
+      upper_name[j] = name[j] - 'a' + 'A';
+    else
+      upper_name[j] = name[j];
+  }
+
+  upper_name[j] = '\0';
+
+  if (it->bytes_per_entry == 1)
+    type = "uint8_t";
+  else if (it->bytes_per_entry == 2)
+    type = "uint16_t";
+  else
+    type = "uint32_t";
+
+  /* each entry is "0x" & 2 hex digits per byte, then ", " */
+  /* (or ",\n  " at the end of a line)                       */
+  num_digits = 2 * it->bytes_per_entry;
+  per_line = 72 / (num_digits + 4);
+
+  buffer = malloc(1024 + it->num_entries * (num_digits + 6));
+
+  if (buffer == NULL)
+  {
+    printf("Write inverse C header failed: Out of memory.\n");
+    return 1;
+  }
+
+  /* header info */
+  p = buffer;
+
+  p += sprintf(p, "/* %s inverse table (rgb%d%d%d, %ld entries) */\n\n",
+               name, it->r_bits, it->g_bits, it->b_bits, it->num_entries);
+
+  p += sprintf(p, "#ifndef PALETTE_%s_%d%d%d_H\n",
+               upper_name, it->r_bits, it->g_bits, it->b_bits);
+  p += sprintf(p, "#define PALETTE_%s_%d%d%d_H\n\n",
+               upper_name, it->r_bits, it->g_bits, it->b_bits);
+
+  p += sprintf(p, "#include <stdint.h>\n\n");
+
+  p += sprintf(p, "#define %s_%d%d%d_NUM_ENTRIES %ld\n\n",
+               upper_name, it->r_bits, it->g_bits, it->b_bits,
+               it->num_entries);
+
+  p += sprintf(p, "/* index = ((r >> %d) << %d) | ((g >> %d) << %d) | "
+                  "(b >> %d) */\n",
+               8 - it->r_bits, it->g_bits + it->b_bits,
+               8 - it->g_bits, it->b_bits, 8 - it->b_bits);
+
+  p += sprintf(p, "static const %s %s_%d%d%d_index[%s_%d%d%d_NUM_ENTRIES] =\n{",
+               type, name, it->r_bits, it->g_bits, it->b_bits,
+               upper_name, it->r_bits, it->g_bits, it->b_bits);
+
+  /* entries (as many as fit in 75 characters per line) */
+  digits = "0123456789abcdef";
+
+  for (k = 0; k < it->num_entries; k++)
+  {
+    if (k % per_line == 0)
+    {
+      memcpy(p, "\n  ", 3);
+      p += 3;
+    }
+    else
+    {
+      p[0] = ' ';
+      p += 1;
+    }
+
+    if (it->bytes_per_entry == 1)
+      value = it->entries[k];
+    else if (it->bytes_per_entry == 2)
+      value = ((unsigned short*) it->entries)[k];
+    else
+      value = ((unsigned int*) it->entries)[k];
+
+    p[0] = '0';
+    p[1] = 'x';
+
+    for (j = 0; j < num_digits; j++)
+      p[2 + j] = digits[(value >> (4 * (num_digits - 1 - j))) & 15];
+
+    p += 2 + num_digits;
+
+    if (k < it->num_entries - 1)
+    {
+      p[0] = ',';
+      p += 1;
+    }
+  }
+
+  p += sprintf(p, "\n};\n\n#endif\n");
+
+  /* write out the file (if it changed) */
+  if (replace_output_file(filename, buffer, p - buffer))
+  {
+    printf("Write inverse C header failed: Unable to write output file.\n");
+    free(buffer);
+    return 1;
+  }
+
+  free(buffer);
+
+  return 0;
+}
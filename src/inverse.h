@@ -0,0 +1,76 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** inverse.h (rgb to palette index tables)
+*******************************************************************************/
+
+#ifndef INVERSE_H
+#define INVERSE_H
+
+#include "palette.h"
+
+/* table formats (bits per channel) */
+enum
+{
+  INVERSE_FORMAT_888 = 0,
+  INVERSE_FORMAT_555,
+  INVERSE_FORMAT_565,
+  INVERSE_NUM_FORMATS
+};
+
+/* the file is the header followed by the entries, in the */
+/* byte order of the machine that wrote it, so that it can */
+/* be mapped into memory & used as is                      */
+#define INVERSE_HEADER_SIZE 32
+
+/* palettes up to this size have their smaller tables filled */
+/* by comparing every entry with every color (larger ones    */
+/* are sampled from the full table)                          */
+#define INVERSE_SEARCH_MAX_COLORS 4096
+
+/* each entry is the index of the nearest palette color to */
+/* an rgb value (with r in the most significant bits, and  */
+/* the lowest index winning ties); the entries are 1, 2 or */
+/* 4 bytes, depending on the palette                       */
+typedef struct inverse_table
+{
+  int             format;
+
+  int             r_bits;
+  int             g_bits;
+  int             b_bits;
+
+  int             bytes_per_entry;
+  int             num_colors;
+  long            num_entries;
+
+  /* the file image (header & entries), allocated or mapped */
+  unsigned char*  data;
+  long            num_bytes;
+  int             mapped;
+
+  unsigned char*  entries;
+} inverse_table;
+
+/* function declarations */
+int       inverse_format_from_name(char* name);
+char*     inverse_format_extension(int format);
+char*     inverse_c_extension(int format);
+
+short int inverse_table_build(inverse_table* it, color* colors,
+                              int num_colors);
+short int inverse_table_reduce(inverse_table* it, inverse_table* full,
+                               int format);
+short int inverse_table_search(inverse_table* it, color* colors,
+                               int num_colors, int format);
+short int inverse_table_open(inverse_table* it, char* filename);
+void      inverse_table_deinit(inverse_table* it);
+
+int       inverse_table_lookup(inverse_table* it, int r, int g, int b);
+
+short int write_inverse_file(inverse_table* it, char* filename);
+short int write_inverse_c_file(inverse_table* it, char* name, char* filename);
+
+#endif
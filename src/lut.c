@@ -0,0 +1,156 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** lut.c (3d lut export)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lut.h"
+#include "nearest.h"
+#include "output.h"
+#include "palette.h"
+#include "parallel.h"
+
+/* each entry is "r.rrrrrr g.gggggg b.bbbbbb\n" */
+#define LUT_VALUE_LENGTH  8
+#define LUT_LINE_LENGTH   (3 * (LUT_VALUE_LENGTH + 1))
+
+typedef struct lut_build
+{
+  nearest_index*  ni;
+  color*          palette;
+
+  int             size;
+  int             grid[LUT_MAX_SIZE];
+
+  char            values[256][LUT_VALUE_LENGTH + 1];
+
+  char*           lines;
+} lut_build;
+
+/*******************************************************************************
+** lut_fill_slice()
+*******************************************************************************/
+static void lut_fill_slice(void* data, int b)
+{
+  lut_build*  lb;
+  color*      c;
+  char*       line;
+
+  int r;
+  int g;
+
+  lb = (lut_build*) data;
+
+  /* red changes fastest, then green, then blue, */
+  /* so each blue value is one contiguous slice  */
+  line = &lb->lines[(long) b * lb->size * lb->size * LUT_LINE_LENGTH];
+
+  for (g = 0; g < lb->size; g++)
+  {
+    for (r = 0; r < lb->size; r++)
+    {
+      c = &lb->palette[nearest_index_query( lb->ni, lb->grid[r],
+                                                    lb->grid[g],
+                                                    lb->grid[b])];
+
+      memcpy(&line[0], lb->values[c->r], LUT_VALUE_LENGTH);
+      line[LUT_VALUE_LENGTH] = ' ';
+      memcpy(&line[LUT_VALUE_LENGTH + 1], lb->values[c->g], LUT_VALUE_LENGTH);
+      line[2 * LUT_VALUE_LENGTH + 1] = ' ';
+      memcpy(&line[2 * LUT_VALUE_LENGTH + 2], lb->values[c->b],
+             LUT_VALUE_LENGTH);
+      line[3 * LUT_VALUE_LENGTH + 2] = '\n';
+
+      line += LUT_LINE_LENGTH;
+    }
+  }
+}
+
+/*******************************************************************************
+** write_cube_file()
+*******************************************************************************/
+short int write_cube_file(palette_context* pc, nearest_index* ni,
+                          int size, char* filename)
+{
+  lut_build lb;
+
+  char      header[256];
+  char*     buffer;
+
+  long      header_bytes;
+  long      num_bytes;
+  int       k;
+
+  /* make sure lut size is valid */
+  if ((size < LUT_MIN_SIZE) || (size > LUT_MAX_SIZE))
+  {
+    printf("Write CUBE file failed: Size must be from %d to %d.\n",
+           LUT_MIN_SIZE, LUT_MAX_SIZE);
+    return 1;
+  }
+
+  /* make sure filename is valid */
+  if (filename == NULL)
+  {
+    printf("Write CUBE file failed: No filename specified.\n");
+    return 1;
+  }
+
+  lb.ni = ni;
+  lb.palette = pc->colors_array;
+  lb.size = size;
+
+  /* input values at each grid point (spread evenly over 0 - 255) */
+  for (k = 0; k < size; k++)
+    lb.grid[k] = ((k * 255) + ((size - 1) / 2)) / (size - 1);
+
+  /* output values are always 8 characters ("0.000000" to "1.000000") */
+  for (k = 0; k < 256; k++)
+    sprintf(lb.values[k], "%.6f", k / 255.0);
+
+  /* header info */
+  header_bytes = sprintf(header, "TITLE \"%s\"\n"
+                                 "LUT_3D_SIZE %d\n"
+                                 "DOMAIN_MIN 0.0 0.0 0.0\n"
+                                 "DOMAIN_MAX 1.0 1.0 1.0\n\n",
+                         pc->title, size);
+
+  /* build the table lines in memory (after the header), one slice per job */
+  num_bytes = header_bytes + (long) size * size * size * LUT_LINE_LENGTH;
+
+  buffer = malloc(num_bytes);
+
+  if (buffer == NULL)
+  {
+    printf("Write CUBE file failed: Out of memory.\n");
+    return 1;
+  }
+
+  memcpy(buffer, header, header_bytes);
+  lb.lines = buffer + header_bytes;
+
+  if (parallel_run(size, lut_fill_slice, &lb))
+  {
+    printf("Write CUBE file failed: Unable to run jobs.\n");
+    free(buffer);
+    return 1;
+  }
+
+  /* write out the file (if it changed) */
+  if (replace_output_file(filename, buffer, num_bytes))
+  {
+    printf("Write CUBE file failed: Unable to write table.\n");
+    free(buffer);
+    return 1;
+  }
+
+  free(buffer);
+
+  return 0;
+}
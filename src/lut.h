@@ -0,0 +1,23 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** lut.h (3d lut export)
+*******************************************************************************/
+
+#ifndef LUT_H
+#define LUT_H
+
+#include "nearest.h"
+#include "palette.h"
+
+/* the .cube format allows 2 to 256 points per axis */
+#define LUT_MIN_SIZE  2
+#define LUT_MAX_SIZE  256
+
+/* function declarations */
+short int write_cube_file(palette_context* pc, nearest_index* ni,
+                          int size, char* filename);
+
+#endif
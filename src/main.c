@@ -9,682 +9,954 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <math.h>
-
-#define PI      3.14159265358979323846f
-#define TWO_PI  6.28318530717958647693f
-
-typedef struct color
-{
-  unsigned char r;
-  unsigned char g;
-  unsigned char b;
-} color;
 
+#include "blend.h"
+#include "cache.h"
+#include "colormap.h"
+#include "inverse.h"
+#include "lut.h"
+#include "nearest.h"
+#include "ntsc.h"
+#include "output.h"
+#include "palette.h"
+#include "parallel.h"
+#include "quantize.h"
+#include "signal.h"
+#include "timer.h"
+
+/* phases reported by --stats */
 enum
 {
-  /* 64 color palettes */
-  SOURCE_APPROX_NES = 0,
-  SOURCE_APPROX_NES_ROTATED,
-  /* 256 color palettes */
-  SOURCE_COMPOSITE_08,
-  SOURCE_COMPOSITE_16,
-  SOURCE_COMPOSITE_16_ROTATED,
-  /* 1024 color palettes */
-  SOURCE_COMPOSITE_32
+  STATS_PHASE_VOLTAGE_TABLES = 0,
+  STATS_PHASE_PHASOR_TABLES,
+  STATS_PHASE_GENERATE,
+  STATS_PHASE_WRITE_GPL,
+  STATS_PHASE_WRITE_TGA,
+  STATS_NUM_PHASES
 };
 
-#if 0
-/* the standard table step is 1 / (n + 2),  */
-/* where n is the number of colors per hue  */
-#define COMPOSITE_08_TABLE_STEP 0.1f                /* 1/10 */
-#define COMPOSITE_16_TABLE_STEP 0.055555555555556f  /* 1/18 */
-#define COMPOSITE_32_TABLE_STEP 0.029411764705882f  /* 1/34 */
-#endif
-
-/* the size of the table step is 1 / (n + 2), */
-/* where n is the number of colors per hue    */
-#define PALETTE_256_COLOR_TABLE_STEP  0.055555555555556f  /* 1/18 (n = 16) */
-#define PALETTE_1024_COLOR_TABLE_STEP 0.029411764705882f  /* 1/34 (n = 32) */
-
-/* the luma is the average of the low and high voltages */
-/* for the 1st half of each table, the low value is 0   */
-/* for the 2nd half of each table, the high value is 1  */
-/* the saturation is half of the peak-to-peak voltage   */
-
-/* for the nes tables, the numbers were obtained    */
-/* from information on the nesdev wiki              */
-/* (see the "NTSC video" and "PPU palettes" pages)  */
-float S_nes_p_p[4] = {0.399f,   0.684f, 0.692f, 0.285f};
-float S_nes_lum[4] = {0.1995f,  0.342f, 0.654f, 0.8575f};
-float S_nes_sat[4] = {0.1995f,  0.342f, 0.346f, 0.1425f};
-
-/* note that if we used the "composite 04" table, */
-/* with the table step being 1/(4+2) = 1/6, we    */
-/* would obtain an approximation of these values! */
-float S_approx_nes_p_p[4] = {0.4f, 0.7f,  0.7f,   0.3f};
-float S_approx_nes_lum[4] = {0.2f, 0.35f, 0.65f,  0.85f};
-float S_approx_nes_sat[4] = {0.2f, 0.35f, 0.35f,  0.15f};
-
-float S_composite_08_lum[8];
-float S_composite_08_sat[8];
-
-float S_composite_16_lum[16];
-float S_composite_16_sat[16];
-
-float S_composite_32_lum[32];
-float S_composite_32_sat[32];
-
-color*  G_colors_array;
-int     G_num_colors;
-int     G_max_colors;
-
-int     G_source;
-
-float*  S_luma_table;
-float*  S_saturation_table;
-int     S_table_length;
+static char* S_stats_phase_names[STATS_NUM_PHASES] =
+  { "voltage tables",
+    "phasor tables",
+    "palette generation",
+    "gpl write",
+    "tga write"
+  };
+
+/* gpl, tga, the embed formats, the cube file, */
+/* the inverse tables, the colormap & the blend */
+/* table                                        */
+#define MAX_OUTPUT_FILES (OUTPUT_NUM_FORMATS + 2 * INVERSE_NUM_FORMATS + 5)
+
+/* inverse tables are written as binary files, c arrays or both */
+#define INVERSE_OUTPUT_BINARY 1
+#define INVERSE_OUTPUT_C      2
+
+typedef struct source_job
+{
+  int       source;
+
+  int       table_length;
+  int       num_hues;
+
+  int       signal_rate;
+  int       signal_filter;
+  int       signal_taps;
+
+  int       num_queries;
+  double    index_seconds;
+  double    query_seconds;
+  int       index_candidates;
+  int       index_mismatches;
+
+  char*           input_filename;
+  char*           output_filename;
+  int             dither;
+  quantize_stats  qstats;
+
+  int       lut_size;
+  double    lut_seconds;
+
+  int       inverse_formats[INVERSE_NUM_FORMATS];
+  double    inverse_seconds;
+
+  int       colormap_levels;
+  color     colormap_fog;
+  double    colormap_seconds;
+
+  /* the blend alpha is negative when no table is written */
+  int       blend_alpha;
+  double    blend_seconds;
+
+  int       embed_formats[OUTPUT_NUM_FORMATS];
+
+  char*     cache_dir;
+  int       cache_hit;
+
+  int       fixed_point;
+  int       verify_fixed;
+  int       verify_mismatches;
+  int       verify_max_difference;
+
+  /* a phase that did not run has a negative time */
+  int       stats;
+  double    phase_seconds[STATS_NUM_PHASES];
+  long      phase_peak_kb[STATS_NUM_PHASES];
+
+  /* the peak memory is reset at the start of each phase when */
+  /* only one palette is generated (& the system allows it)   */
+  int       reset_peak;
+  int       phase_peak_reset;
+  int       num_clamped;
+
+  char      name[PALETTE_NAME_LENGTH];
+  int       num_colors;
+  short int status;
+} source_job;
 
 /*******************************************************************************
-** generate_voltage_tables()
+** benchmark_index()
 *******************************************************************************/
-short int generate_voltage_tables()
+static short int benchmark_index(source_job* job, palette_context* pc)
 {
-  int k;
+  nearest_index ni;
 
-  /* composite 08 tables */
-  for (k = 0; k < 4; k++)
-  {
-    /* the table should include steps 1, 3, 6, and 8 */
-    if (k < 2)
-      S_composite_08_lum[k] = (2 * k + 1) * PALETTE_256_COLOR_TABLE_STEP;
-    else
-      S_composite_08_lum[k] = (2 * k + 2) * PALETTE_256_COLOR_TABLE_STEP;
+  color*  pixels;
+  int*    indices;
 
-    S_composite_08_lum[7 - k] = 1.0f - S_composite_08_lum[k];
+  unsigned long seed;
+  double        start;
 
-    S_composite_08_sat[k] = S_composite_08_lum[k];
-    S_composite_08_sat[7 - k] = S_composite_08_sat[k];
+  int k;
+
+  pixels = malloc(sizeof(color) * job->num_queries);
+  indices = malloc(sizeof(int) * job->num_queries);
+
+  if ((pixels == NULL) || (indices == NULL))
+  {
+    free(pixels);
+    free(indices);
+    return 1;
   }
 
-  /* composite 16 tables */
-  for (k = 0; k < 8; k++)
+  /* random query colors (fixed seed, so runs are repeatable) */
+  seed = 12345;
+
+  for (k = 0; k < job->num_queries; k++)
   {
-    S_composite_16_lum[k] = (k + 1) * PALETTE_256_COLOR_TABLE_STEP;
-    S_composite_16_lum[15 - k] = 1.0f - S_composite_16_lum[k];
+    seed = (seed * 1103515245 + 12345) & 0xFFFFFFFF;
 
-    S_composite_16_sat[k] = S_composite_16_lum[k];
-    S_composite_16_sat[15 - k] = S_composite_16_sat[k];
+    pixels[k].r = (seed >> 24) & 0xFF;
+    pixels[k].g = (seed >> 16) & 0xFF;
+    pixels[k].b = (seed >> 8) & 0xFF;
   }
 
-  /* composite 32 tables */
-  for (k = 0; k < 16; k++)
+  /* build index */
+  start = timer_seconds();
+
+  if (nearest_index_init(&ni, pc->colors_array, pc->num_colors))
   {
-    S_composite_32_lum[k] = (k + 1) * PALETTE_1024_COLOR_TABLE_STEP;
-    S_composite_32_lum[31 - k] = 1.0f - S_composite_32_lum[k];
+    free(pixels);
+    free(indices);
+    return 1;
+  }
+
+  job->index_seconds = timer_seconds() - start;
+  job->index_candidates = ni.num_candidates;
+
+  /* run queries */
+  start = timer_seconds();
+
+  nearest_index_query_batch(&ni, pixels, job->num_queries, indices);
 
-    S_composite_32_sat[k] = S_composite_32_lum[k];
-    S_composite_32_sat[31 - k] = S_composite_32_sat[k];
+  job->query_seconds = timer_seconds() - start;
+
+  /* check the first queries against a linear search */
+  job->index_mismatches = 0;
+
+  for (k = 0; (k < job->num_queries) && (k < 4096); k++)
+  {
+    if (indices[k] != nearest_search( pc->colors_array, pc->num_colors,
+                                      pixels[k].r, pixels[k].g, pixels[k].b))
+    {
+      job->index_mismatches += 1;
+    }
   }
 
+  nearest_index_deinit(&ni);
+
+  free(pixels);
+  free(indices);
+
   return 0;
 }
 
 /*******************************************************************************
-** set_voltage_table_pointers()
+** quantize_source()
 *******************************************************************************/
-short int set_voltage_table_pointers()
+static short int quantize_source(source_job* job, palette_context* pc)
 {
-  if ((G_source == SOURCE_APPROX_NES) || 
-      (G_source == SOURCE_APPROX_NES_ROTATED))
-  {
-    S_luma_table = S_approx_nes_lum;
-    S_saturation_table = S_approx_nes_sat;
-    S_table_length = 4;
-  }
-  else if (G_source == SOURCE_COMPOSITE_08)
-  {
-    S_luma_table = S_composite_08_lum;
-    S_saturation_table = S_composite_08_sat;
-    S_table_length = 8;
-  }
-  else if ( (G_source == SOURCE_COMPOSITE_16) || 
-            (G_source == SOURCE_COMPOSITE_16_ROTATED))
-  {
-    S_luma_table = S_composite_16_lum;
-    S_saturation_table = S_composite_16_sat;
-    S_table_length = 16;
-  }
-  else if (G_source == SOURCE_COMPOSITE_32)
-  {
-    S_luma_table = S_composite_32_lum;
-    S_saturation_table = S_composite_32_sat;
-    S_table_length = 32;
-  }
-  else
+  nearest_index ni;
+
+  if (nearest_index_init(&ni, pc->colors_array, pc->num_colors))
+    return 1;
+
+  if (quantize_image(pc, &ni, job->input_filename, job->output_filename,
+                     job->dither, &job->qstats))
   {
-    printf("Cannot set voltage table pointers; invalid source specified.\n");
+    nearest_index_deinit(&ni);
     return 1;
   }
 
+  nearest_index_deinit(&ni);
+
   return 0;
 }
 
 /*******************************************************************************
-** add_color()
+** write_lut_source()
 *******************************************************************************/
-short int add_color(unsigned char r, unsigned char g, unsigned char b)
+static short int write_lut_source(source_job* job, palette_context* pc,
+                                  char* filename)
 {
-  /* make sure array index is valid */
-  if ((G_num_colors < 0) || (G_num_colors >= G_max_colors))
+  nearest_index ni;
+
+  double start;
+
+  start = timer_seconds();
+
+  if (nearest_index_init(&ni, pc->colors_array, pc->num_colors))
+    return 1;
+
+  if (write_cube_file(pc, &ni, job->lut_size, filename))
   {
-    printf("Unable to add color: Colors array is filled.\n");
+    nearest_index_deinit(&ni);
     return 1;
   }
 
-  /* add color */
-  G_colors_array[G_num_colors].r = r;
-  G_colors_array[G_num_colors].g = g;
-  G_colors_array[G_num_colors].b = b;
+  nearest_index_deinit(&ni);
 
-  G_num_colors += 1;
+  job->lut_seconds = timer_seconds() - start;
 
   return 0;
 }
 
 /*******************************************************************************
-** generate_palette_approx_nes()
+** write_colormap_source()
 *******************************************************************************/
-short int generate_palette_approx_nes()
+static short int write_colormap_source(source_job* job, palette_context* pc,
+                                       char* filename)
 {
-  int   k;
-  int   m;
+  nearest_index ni;
 
-  float y;
-  float i;
-  float q;
+  double start;
 
-  int   r;
-  int   g;
-  int   b;
+  start = timer_seconds();
 
-  int   hue;
-  int   step;
+  if (nearest_index_init(&ni, pc->colors_array, pc->num_colors))
+    return 1;
 
-  /* set hue step & hue start */
-  if (G_source == SOURCE_APPROX_NES)
-  {
-    step = 30;
-    hue = 0;
-  }
-  else if (G_source == SOURCE_APPROX_NES_ROTATED)
+  if (write_colormap_file(pc, &ni, job->colormap_levels,
+                          job->colormap_fog, filename))
   {
-    step = 30;
-    hue = 15;
+    nearest_index_deinit(&ni);
+    return 1;
   }
-  else
+
+  nearest_index_deinit(&ni);
+
+  job->colormap_seconds = timer_seconds() - start;
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_blend_source()
+*******************************************************************************/
+static short int write_blend_source(source_job* job, palette_context* pc,
+                                    char* filename)
+{
+  nearest_index ni;
+
+  double start;
+
+  start = timer_seconds();
+
+  if (nearest_index_init(&ni, pc->colors_array, pc->num_colors))
+    return 1;
+
+  if (write_blend_file(pc, &ni, job->blend_alpha, filename))
   {
-    step = 30;
-    hue = 0;
+    nearest_index_deinit(&ni);
+    return 1;
   }
 
-  /* add pure black */
-  add_color(0, 0, 0);
+  nearest_index_deinit(&ni);
+
+  job->blend_seconds = timer_seconds() - start;
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_inverse_source()
+*******************************************************************************/
+static short int write_inverse_source(source_job* job, palette_context* pc,
+                                      char* base_filename)
+{
+  inverse_table   full;
+  inverse_table   reduced;
+  inverse_table*  it;
+
+  char    filename[256];
+
+  double  start;
+  int     status;
+  int     k;
 
-  /* add greys */
-  for (k = 0; k < S_table_length; k++)
+  start = timer_seconds();
+
+  /* the full table is only built if it is written, or if */
+  /* the palette is too large to search for each entry    */
+  full.data = NULL;
+
+  for (k = 0; k < INVERSE_NUM_FORMATS; k++)
   {
-    r = (int) ((S_luma_table[k] * 255) + 0.5f);
-    g = (int) ((S_luma_table[k] * 255) + 0.5f);
-    b = (int) ((S_luma_table[k] * 255) + 0.5f);
+    if (job->inverse_formats[k] &&
+        ((k == INVERSE_FORMAT_888) ||
+         (pc->num_colors > INVERSE_SEARCH_MAX_COLORS)))
+    {
+      if (inverse_table_build(&full, pc->colors_array, pc->num_colors))
+        return 1;
 
-    add_color(r, g, b);
+      break;
+    }
   }
 
-  /* add pure white */
-  add_color(255, 255, 255);
+  status = 0;
 
-  /* add hues */
-  for (m = 0; m < 360 / step; m++)
+  for (k = 0; (k < INVERSE_NUM_FORMATS) && (status == 0); k++)
   {
-    /* generate hue */
-    for (k = 0; k < S_table_length; k++)
+    if (!job->inverse_formats[k])
+      continue;
+
+    reduced.data = NULL;
+
+    if (k == INVERSE_FORMAT_888)
+      it = &full;
+    else if (pc->num_colors <= INVERSE_SEARCH_MAX_COLORS)
+    {
+      if (inverse_table_search(&reduced, pc->colors_array, pc->num_colors, k))
+        status = 1;
+
+      it = &reduced;
+    }
+    else
     {
-      y = S_luma_table[k];
-      i = S_saturation_table[k] * cos(TWO_PI * hue / 360.0f);
-      q = S_saturation_table[k] * sin(TWO_PI * hue / 360.0f);
+      if (inverse_table_reduce(&reduced, &full, k))
+        status = 1;
 
-      r = (int) (((y + (i * 0.956f) + (q * 0.619f)) * 255) + 0.5f);
-      g = (int) (((y - (i * 0.272f) - (q * 0.647f)) * 255) + 0.5f);
-      b = (int) (((y - (i * 1.106f) + (q * 1.703f)) * 255) + 0.5f);
+      it = &reduced;
+    }
 
-      /* bound rgb values */
-      if (r < 0)
-        r = 0;
-      else if (r > 255)
-        r = 255;
+    /* binary table */
+    if ((status == 0) && (job->inverse_formats[k] & INVERSE_OUTPUT_BINARY))
+    {
+      strcpy(filename, base_filename);
+      strcat(filename, inverse_format_extension(k));
 
-      if (g < 0)
-        g = 0;
-      else if (g > 255)
-        g = 255;
+      status = write_inverse_file(it, filename);
+    }
 
-      if (b < 0)
-        b = 0;
-      else if (b > 255)
-        b = 255;
+    /* c array */
+    if ((status == 0) && (job->inverse_formats[k] & INVERSE_OUTPUT_C))
+    {
+      strcpy(filename, base_filename);
+      strcat(filename, inverse_c_extension(k));
 
-      /* add color to the palette */
-      add_color(r, g, b);
+      status = write_inverse_c_file(it, pc->name, filename);
     }
 
-    /* increment hue */
-    hue += step;
-    hue = hue % 360;
+    inverse_table_deinit(&reduced);
   }
 
-  return 0;
+  inverse_table_deinit(&full);
+
+  job->inverse_seconds = timer_seconds() - start;
+
+  return status;
 }
 
 /*******************************************************************************
-** generate_palette_composite()
+** verify_fixed_point()
 *******************************************************************************/
-short int generate_palette_composite()
+static short int verify_fixed_point(source_job* job, palette_context* pc)
 {
-  int   k;
-  int   m;
-
-  float y;
-  float i;
-  float q;
-
-  int   r;
-  int   g;
-  int   b;
+  palette_context other;
 
-  int   num_hues;
-  float phi;
+  int k;
+  int d;
 
-  /* determine number of hues */
-  if ((G_source == SOURCE_COMPOSITE_16) || 
-      (G_source == SOURCE_COMPOSITE_16_ROTATED))
+  /* generate the same palette with the other decode path */
+  if (pc->source == SOURCE_SIGNAL)
   {
-    num_hues = 12;
+    if (palette_init_signal(&other, pc->table_length, pc->num_hues))
+      return 1;
   }
-  else if ( (G_source == SOURCE_COMPOSITE_08) || 
-            (G_source == SOURCE_COMPOSITE_32))
+  else if (palette_source_is_custom(pc->source))
   {
-    num_hues = 24;
+    if (palette_init_custom(&other, pc->table_length, pc->num_hues))
+      return 1;
   }
-  else
-    num_hues = 12;
+  else if (palette_init(&other, pc->source))
+    return 1;
 
-  /* determine phase offset */
-  if (G_source == SOURCE_COMPOSITE_16_ROTATED)
-  {
-    phi = PI / 12.0f; /* 15 degrees */
-  }
-  else
-    phi = 0.0f;
+  other.fixed_point = !pc->fixed_point;
 
-  /* add greys */
-  for (k = 0; k < S_table_length; k++)
-  {
-    r = (int) ((S_luma_table[k] * 255) + 0.5f);
-    g = (int) ((S_luma_table[k] * 255) + 0.5f);
-    b = (int) ((S_luma_table[k] * 255) + 0.5f);
+  other.signal_rate = pc->signal_rate;
+  other.signal_filter = pc->signal_filter;
+  other.signal_taps = pc->signal_taps;
 
-    add_color(r, g, b);
+  if (palette_generate(&other) || (other.num_colors != pc->num_colors))
+  {
+    palette_deinit(&other);
+    return 1;
   }
 
-  /* add hues */
-  for (m = 0; m < num_hues; m++)
+  /* count colors that differ, and find the largest difference */
+  job->verify_mismatches = 0;
+  job->verify_max_difference = 0;
+
+  for (k = 0; k < pc->num_colors; k++)
   {
-    /* generate hue */
-    for (k = 0; k < S_table_length; k++)
-    {
-      y = S_luma_table[k];
-      i = S_saturation_table[k] * cos(((TWO_PI * m) / num_hues) + phi);
-      q = S_saturation_table[k] * sin(((TWO_PI * m) / num_hues) + phi);
+    d = abs(pc->colors_array[k].r - other.colors_array[k].r);
 
-      r = (int) (((y + (i * 0.956f) + (q * 0.619f)) * 255) + 0.5f);
-      g = (int) (((y - (i * 0.272f) - (q * 0.647f)) * 255) + 0.5f);
-      b = (int) (((y - (i * 1.106f) + (q * 1.703f)) * 255) + 0.5f);
+    if (abs(pc->colors_array[k].g - other.colors_array[k].g) > d)
+      d = abs(pc->colors_array[k].g - other.colors_array[k].g);
 
-      /* bound rgb values */
-      if (r < 0)
-        r = 0;
-      if (g < 0)
-        g = 0;
-      if (b < 0)
-        b = 0;
+    if (abs(pc->colors_array[k].b - other.colors_array[k].b) > d)
+      d = abs(pc->colors_array[k].b - other.colors_array[k].b);
 
-      if (r > 255)
-        r = 255;
-      if (g > 255)
-        g = 255;
-      if (b > 255)
-        b = 255;
+    if (d > 0)
+      job->verify_mismatches += 1;
 
-      /* add color to the palette */
-      add_color(r, g, b);
-    }
+    if (d > job->verify_max_difference)
+      job->verify_max_difference = d;
   }
 
+  palette_deinit(&other);
+
   return 0;
 }
 
 /*******************************************************************************
-** write_gpl_file()
+** list_output_files()
 *******************************************************************************/
-short int write_gpl_file(char* filename)
+static int list_output_files(source_job* job, char** extensions, int* params)
 {
-  FILE* fp_out;
+  int num_files;
+  int k;
+
+  num_files = 0;
+
+  /* palette files (these are not written when quantizing) */
+  if (job->input_filename == NULL)
+  {
+    extensions[num_files] = ".gpl";
+    params[num_files] = 0;
+    num_files += 1;
 
-  int   color_index;
+    extensions[num_files] = ".tga";
+    params[num_files] = 0;
+    num_files += 1;
 
-  unsigned char r;
-  unsigned char g;
-  unsigned char b;
+    for (k = 0; k < OUTPUT_NUM_FORMATS; k++)
+    {
+      if (job->embed_formats[k])
+      {
+        extensions[num_files] = output_format_extension(k);
+        params[num_files] = 0;
+        num_files += 1;
+      }
+    }
+  }
 
-  fp_out = NULL;
+  /* cube file (which also depends on the lut size) */
+  if (job->lut_size > 0)
+  {
+    extensions[num_files] = ".cube";
+    params[num_files] = job->lut_size;
+    num_files += 1;
+  }
 
-  /* check that output gpl file was given */
-  if (filename == NULL)
+  /* inverse tables */
+  for (k = 0; k < INVERSE_NUM_FORMATS; k++)
   {
-    printf("No output GPL file specified. Exiting...\n");
-    return 1;
+    if (job->inverse_formats[k] & INVERSE_OUTPUT_BINARY)
+    {
+      extensions[num_files] = inverse_format_extension(k);
+      params[num_files] = 0;
+      num_files += 1;
+    }
+
+    if (job->inverse_formats[k] & INVERSE_OUTPUT_C)
+    {
+      extensions[num_files] = inverse_c_extension(k);
+      params[num_files] = 0;
+      num_files += 1;
+    }
   }
 
-  /* open output file */
-  fp_out = fopen(filename, "w");
+  /* colormap (which also depends on the levels & the fog color; */
+  /* at most 128 levels leaves room for the color in the param)  */
+  if (job->colormap_levels > 0)
+  {
+    extensions[num_files] = ".cmap";
+    params[num_files] = (job->colormap_levels - 1) |
+                        (((job->colormap_fog.r << 16) |
+                          (job->colormap_fog.g << 8) |
+                          job->colormap_fog.b) << 7);
+    num_files += 1;
+  }
 
-  /* if file did not open, return */
-  if (fp_out == NULL)
+  /* blend table (which also depends on the alpha) */
+  if (job->blend_alpha >= 0)
   {
-    printf("Unable to open output GPL file. Exiting...\n");
-    return 1;
+    extensions[num_files] = ".blend";
+    params[num_files] = job->blend_alpha;
+    num_files += 1;
   }
 
-  /* write out header info */
-  fprintf(fp_out, "GIMP Palette\n");
+  return num_files;
+}
 
-  if (G_source == SOURCE_APPROX_NES)
-    fprintf(fp_out, "Name: Approximate NES\n");
-  else if (G_source == SOURCE_APPROX_NES_ROTATED)
-    fprintf(fp_out, "Name: Approximate NES Rotated\n");
-  else if (G_source == SOURCE_COMPOSITE_08)
-    fprintf(fp_out, "Name: Composite 08\n");
-  else if (G_source == SOURCE_COMPOSITE_16)
-    fprintf(fp_out, "Name: Composite 16\n");
-  else if (G_source == SOURCE_COMPOSITE_16_ROTATED)
-    fprintf(fp_out, "Name: Composite 16 Rotated\n");
-  else if (G_source == SOURCE_COMPOSITE_32)
-    fprintf(fp_out, "Name: Composite 32\n");
+/*******************************************************************************
+** cache_output_files()
+*******************************************************************************/
+static short int cache_output_files(source_job* job, palette_context* pc,
+                                    char* base_filename, int store)
+{
+  char* extensions[MAX_OUTPUT_FILES];
+  int   params[MAX_OUTPUT_FILES];
+  int   num_files;
 
-  fprintf(fp_out, "Columns: 16\n\n");
+  char  key[CACHE_KEY_LENGTH];
+  char  filename[256];
 
-  /* write out palette colors */
-  for (color_index = 0; color_index < G_num_colors; color_index++)
-  {
-    r = G_colors_array[color_index].r;
-    g = G_colors_array[color_index].g;
-    b = G_colors_array[color_index].b;
+  int   k;
 
-    if (r < 10)
-      fprintf(fp_out, "  %d ", r);
-    else if (r < 100)
-      fprintf(fp_out, " %d ", r);
-    else
-      fprintf(fp_out, "%d ", r);
+  num_files = list_output_files(job, extensions, params);
 
-    if (g < 10)
-      fprintf(fp_out, "  %d ", g);
-    else if (g < 100)
-      fprintf(fp_out, " %d ", g);
-    else
-      fprintf(fp_out, "%d ", g);
+  for (k = 0; k < num_files; k++)
+  {
+    cache_make_key(pc, extensions[k], params[k], key);
 
-    if (b < 10)
-      fprintf(fp_out, "  %d", b);
-    else if (b < 100)
-      fprintf(fp_out, " %d", b);
-    else
-      fprintf(fp_out, "%d", b);
+    strcpy(filename, base_filename);
+    strcat(filename, extensions[k]);
 
-    fprintf(fp_out, "\t(%d, %d, %d)\n", r, g, b);
+    /* store every output, or fetch until the first miss */
+    if (store)
+      cache_store(job->cache_dir, key, extensions[k], filename);
+    else if (cache_fetch(job->cache_dir, key, extensions[k], filename))
+      return 1;
   }
 
-  /* close file */
-  fclose(fp_out);
-
   return 0;
 }
 
 /*******************************************************************************
-** write_tga_file()
+** begin_phase()
 *******************************************************************************/
-short int write_tga_file(char* filename)
+static double begin_phase(source_job* job)
 {
-  FILE* fp_out;
+  if (job->stats && job->reset_peak)
+    job->phase_peak_reset = !timer_reset_peak_memory();
 
-  unsigned char image_id_field_length;
-  unsigned char color_map_type;
-  unsigned char image_type;
-  unsigned char image_descriptor;
+  return timer_seconds();
+}
 
-  unsigned char color_map_specification[5];
+/*******************************************************************************
+** end_phase()
+*******************************************************************************/
+static void end_phase(source_job* job, int phase, double start)
+{
+  job->phase_seconds[phase] = timer_seconds() - start;
 
-  short int     x_origin;
-  short int     y_origin;
+  if (job->stats)
+    job->phase_peak_kb[phase] = timer_peak_memory_kb();
+}
 
-  short int     image_w;
-  short int     image_h;
+/*******************************************************************************
+** generate_source()
+*******************************************************************************/
+static void generate_source(void* data, int index)
+{
+  source_job*     job;
+  palette_context pc;
 
-  unsigned char pixel_bpp;
-  short int     pixel_num_bytes;
+  char  output_base_filename[256];
+  char  output_gpl_filename[256];
+  char  output_tga_filename[256];
+  char  output_cube_filename[256];
+  char  output_cmap_filename[256];
+  char  output_blend_filename[256];
+  char  output_embed_filename[256];
 
-  unsigned char output_buffer[3];
+  double start;
+  int    use_cache;
+  int    k;
 
-  int           color_index;
+  job = ((source_job*) data) + index;
 
-  /* make sure number of colors is < 1024 */
-  if (G_num_colors >= 1024)
-  {
-    printf("Write TGA file failed: Number of colors >= 1024.\n");
-    return 0;
-  }
+  job->name[0] = '\0';
+  job->num_colors = 0;
+  job->num_clamped = 0;
+  job->cache_hit = 0;
+  job->inverse_seconds = 0.0;
+  job->status = 1;
 
-  /* make sure filename is valid */
-  if (filename == NULL)
+  for (k = 0; k < STATS_NUM_PHASES; k++)
   {
-    printf("Write TGA file failed: No filename specified.\n");
-    return 1;
+    job->phase_seconds[k] = -1.0;
+    job->phase_peak_kb[k] = 0;
   }
 
-  /* open file */
-  fp_out = fopen(filename, "wb");
+  job->phase_peak_reset = 0;
 
-  /* if file did not open, return error */
-  if (fp_out == NULL)
+  /* initialize palette context */
+  if (job->source == SOURCE_SIGNAL)
   {
-    printf("Write TGA file failed: Unable to open output file.\n");
-    return 1;
+    if (palette_init_signal(&pc, job->table_length, job->num_hues))
+      return;
   }
+  else if (palette_source_is_custom(job->source))
+  {
+    if (palette_init_custom(&pc, job->table_length, job->num_hues))
+      return;
+  }
+  else if (palette_init(&pc, job->source))
+    return;
 
-  /* initialize parameters */
-  image_id_field_length = 0;
-  color_map_type = 0;
-  image_type = 2;
-  image_descriptor = 0x20;
+  strcpy(job->name, pc.name);
 
-  color_map_specification[0] = 0;
-  color_map_specification[1] = 0;
-  color_map_specification[2] = 0;
-  color_map_specification[3] = 0;
-  color_map_specification[4] = 0;
+  pc.fixed_point = job->fixed_point;
 
-  x_origin = 0;
-  y_origin = 0;
+  pc.signal_rate = job->signal_rate;
+  pc.signal_filter = job->signal_filter;
+  pc.signal_taps = job->signal_taps;
 
-  if (G_num_colors <= 64)
-    image_w = 64;
-  else if (G_num_colors <= 256)
-    image_w = 256;
-  else if (G_num_colors <= 1024)
-    image_w = 1024;
-  else
-    image_w = 1024;
+  /* generate output filenames */
+  strncpy(output_base_filename, pc.name, 240);
+  output_base_filename[240] = '\0';
+
+  strcpy(output_gpl_filename, output_base_filename);
+  strcpy(output_tga_filename, output_base_filename);
+  strcpy(output_cube_filename, output_base_filename);
+  strcpy(output_cmap_filename, output_base_filename);
+  strcpy(output_blend_filename, output_base_filename);
+
+  strcat(output_gpl_filename, ".gpl");
+  strcat(output_tga_filename, ".tga");
+  strcat(output_cube_filename, ".cube");
+  strcat(output_cmap_filename, ".cmap");
+  strcat(output_blend_filename, ".blend");
+
+  /* the cache only holds output files, so it is not used */
+  /* when the palette itself is needed for something else */
+  use_cache = (job->cache_dir != NULL)      &&
+              (job->input_filename == NULL) &&
+              (job->num_queries == 0)       &&
+              (!job->verify_fixed);
+
+  /* if every output file is in the cache, there is nothing to generate */
+  if (use_cache)
+  {
+    if (!cache_output_files(job, &pc, output_base_filename, 0))
+    {
+      job->cache_hit = 1;
 
-  image_h = 1;
+      palette_deinit(&pc);
 
-  pixel_bpp = 24;
-  pixel_num_bytes = 3;
+      job->status = 0;
+      return;
+    }
+  }
 
-  output_buffer[0] = 0;
-  output_buffer[1] = 0;
-  output_buffer[2] = 0;
+  /* generate voltage tables */
+  start = begin_phase(job);
 
-  /* write image id field length */
-  if (fwrite(&image_id_field_length, 1, 1, fp_out) < 1)
+  if (generate_voltage_tables(&pc))
   {
-    fclose(fp_out);
-    return 1;
+    palette_deinit(&pc);
+    return;
   }
 
-  /* write colormap type */
-  if (fwrite(&color_map_type, 1, 1, fp_out) < 1)
-  {
-    fclose(fp_out);
-    return 1;
-  }
+  end_phase(job, STATS_PHASE_VOLTAGE_TABLES, start);
+
+  /* generate phasor tables */
+  start = begin_phase(job);
 
-  /* write image type */
-  if (fwrite(&image_type, 1, 1, fp_out) < 1)
+  if (generate_phasor_tables(&pc))
   {
-    fclose(fp_out);
-    return 1;
+    palette_deinit(&pc);
+    return;
   }
 
-  /* write colormap specification */
-  if (fwrite(color_map_specification, 1, 5, fp_out) < 1)
+  end_phase(job, STATS_PHASE_PHASOR_TABLES, start);
+
+  /* generate palette */
+  start = begin_phase(job);
+
+  if (generate_palette_colors(&pc))
   {
-    fclose(fp_out);
-    return 1;
+    palette_deinit(&pc);
+    return;
   }
 
-  /* write x origin */
-  if (fwrite(&x_origin, 2, 1, fp_out) < 1)
+  end_phase(job, STATS_PHASE_GENERATE, start);
+
+  job->num_colors = pc.num_colors;
+  job->num_clamped = pc.num_clamped;
+
+  /* compare the fixed-point & float decode paths */
+  if (job->verify_fixed)
   {
-    fclose(fp_out);
-    return 1;
+    if (verify_fixed_point(job, &pc))
+    {
+      palette_deinit(&pc);
+      return;
+    }
   }
 
-  /* write y origin */
-  if (fwrite(&y_origin, 2, 1, fp_out) < 1)
+  /* benchmark nearest color index */
+  if (job->num_queries > 0)
   {
-    fclose(fp_out);
-    return 1;
+    if (benchmark_index(job, &pc))
+    {
+      palette_deinit(&pc);
+      return;
+    }
   }
 
-  /* write image width */
-  if (fwrite(&image_w, 2, 1, fp_out) < 1)
+  /* quantize input image (instead of writing out the palette) */
+  if (job->input_filename != NULL)
   {
-    fclose(fp_out);
-    return 1;
+    if (quantize_source(job, &pc))
+    {
+      palette_deinit(&pc);
+      return;
+    }
   }
-
-  /* write image height */
-  if (fwrite(&image_h, 2, 1, fp_out) < 1)
+  else
   {
-    fclose(fp_out);
-    return 1;
+    /* write output gpl file */
+    start = begin_phase(job);
+
+    if (write_gpl_file(&pc, output_gpl_filename))
+    {
+      palette_deinit(&pc);
+      return;
+    }
+
+    end_phase(job, STATS_PHASE_WRITE_GPL, start);
+
+    /* write output tga file */
+    start = begin_phase(job);
+
+    if (write_tga_file(&pc, output_tga_filename))
+    {
+      palette_deinit(&pc);
+      return;
+    }
+
+    end_phase(job, STATS_PHASE_WRITE_TGA, start);
+
+    /* write output embed files */
+    for (k = 0; k < OUTPUT_NUM_FORMATS; k++)
+    {
+      if (!job->embed_formats[k])
+        continue;
+
+      strcpy(output_embed_filename, output_base_filename);
+      strcat(output_embed_filename, output_format_extension(k));
+
+      if (write_output_file(&pc, output_embed_filename, k))
+      {
+        palette_deinit(&pc);
+        return;
+      }
+    }
   }
 
-  /* write pixel bpp */
-  if (fwrite(&pixel_bpp, 1, 1, fp_out) < 1)
+  /* write output cube file */
+  if (job->lut_size > 0)
   {
-    fclose(fp_out);
-    return 1;
+    if (write_lut_source(job, &pc, output_cube_filename))
+    {
+      palette_deinit(&pc);
+      return;
+    }
   }
 
-  /* write image descriptor */
-  if (fwrite(&image_descriptor, 1, 1, fp_out) < 1)
+  /* write output inverse tables */
+  for (k = 0; k < INVERSE_NUM_FORMATS; k++)
   {
-    fclose(fp_out);
-    return 1;
+    if (job->inverse_formats[k])
+    {
+      if (write_inverse_source(job, &pc, output_base_filename))
+      {
+        palette_deinit(&pc);
+        return;
+      }
+
+      break;
+    }
   }
 
-  /* write palette colors */
-  for (color_index = 0; color_index < G_num_colors; color_index++)
+  /* write output colormap */
+  if (job->colormap_levels > 0)
   {
-    output_buffer[2] = G_colors_array[color_index].r;
-    output_buffer[1] = G_colors_array[color_index].g;
-    output_buffer[0] = G_colors_array[color_index].b;
-
-    if (fwrite(output_buffer, 1, 3, fp_out) < 1)
+    if (write_colormap_source(job, &pc, output_cmap_filename))
     {
-      fclose(fp_out);
-      return 1;
+      palette_deinit(&pc);
+      return;
     }
   }
 
-  /* fill remaining spaces with zeroes */
-  for (color_index = G_num_colors; color_index < image_w; color_index++)
+  /* write output blend table */
+  if (job->blend_alpha >= 0)
   {
-    output_buffer[2] = 0;
-    output_buffer[1] = 0;
-    output_buffer[0] = 0;
-
-    if (fwrite(output_buffer, 1, 3, fp_out) < 1)
+    if (write_blend_source(job, &pc, output_blend_filename))
     {
-      fclose(fp_out);
-      return 1;
+      palette_deinit(&pc);
+      return;
     }
   }
 
-  /* close file */
-  fclose(fp_out);
+  /* store output files in the cache (only reached once every */
+  /* writer above has succeeded, so that a stale file left by  */
+  /* an earlier run is never stored under this key)            */
+  if (use_cache)
+    cache_output_files(job, &pc, output_base_filename, 1);
 
-  return 0;
+  /* free palette context */
+  palette_deinit(&pc);
+
+  job->status = 0;
 }
 
 /*******************************************************************************
-** main()
+** print_stats()
 *******************************************************************************/
-int main(int argc, char *argv[])
+static void print_stats(source_job* job, int num_jobs)
 {
-  int   i;
+  int k;
 
-  char  output_base_filename[256];
-  char  output_gpl_filename[256];
-  char  output_tga_filename[256];
+  printf("Stats (%s):\n", job->name);
 
-  /* initialization */
-  G_colors_array = NULL;
-  G_num_colors = 0;
-  G_max_colors = 0;
+  for (k = 0; k < STATS_NUM_PHASES; k++)
+  {
+    if (job->phase_seconds[k] < 0.0)
+      continue;
 
-  output_base_filename[0] = '\0';
-  output_gpl_filename[0] = '\0';
-  output_tga_filename[0] = '\0';
+    printf("  %-20s %10.3f ms   %-12s %8ld KB\n",
+           S_stats_phase_names[k], job->phase_seconds[k] * 1000.0,
+           job->phase_peak_reset ? "peak memory" : "process peak",
+           job->phase_peak_kb[k]);
+  }
 
-  /* initialize variables */
-  G_source = SOURCE_APPROX_NES;
+  printf("  %-20s %d of %d", "clamped colors",
+         job->num_clamped, job->num_colors);
 
-  S_luma_table = S_approx_nes_lum;
-  S_saturation_table = S_approx_nes_sat;
-  S_table_length = 4;
+  if (job->num_colors > 0)
+    printf(" (%.1f%%)", (100.0 * job->num_clamped) / job->num_colors);
 
-  /* generate voltage tables */
-  generate_voltage_tables();
+  printf("\n");
 
-  /* read command line arguments */
-  i = 1;
+  /* the process peak also includes any */
+  /* palettes generated at the same time */
+  if (num_jobs > 1)
+    printf("  (process peak is shared by all palettes)\n");
+}
 
-  while (i < argc)
-  {
-    /* source */
+/*******************************************************************************
+** main()
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+  int   i;
+  int   k;
+
+  int   source;
+
+  int   table_length;
+  int   num_hues;
+  int   signal_rate;
+  int   signal_filter;
+  int   signal_taps;
+  int   num_queries;
+
+  char* input_filename;
+  char* output_filename;
+  int   dither;
+  int   ntsc;
+  int   ntsc_frame;
+  int   lut_size;
+  int   stats;
+  int   fixed_point;
+  int   verify_fixed;
+  int   embed_formats[OUTPUT_NUM_FORMATS];
+  int   inverse_formats[INVERSE_NUM_FORMATS];
+  int   colormap_levels;
+  color colormap_fog;
+  int   blend_alpha;
+  long  value;
+  int   format;
+  char* cache_dir;
+
+  source_job  jobs[SOURCE_NUM_SOURCES];
+  int         num_jobs;
+
+  ntsc_stats  nstats;
+
+  /* initialization */
+  num_jobs = 0;
+
+  table_length = 16;
+  num_hues = 12;
+  signal_rate = SIGNAL_DEFAULT_RATE;
+  signal_filter = SIGNAL_FILTER_BOX;
+  signal_taps = 0;
+  num_queries = 0;
+
+  input_filename = NULL;
+  output_filename = NULL;
+  dither = QUANTIZE_DITHER_NONE;
+  ntsc = 0;
+  ntsc_frame = 0;
+  lut_size = 0;
+  colormap_levels = 0;
+  colormap_fog.r = 0;
+  colormap_fog.g = 0;
+  colormap_fog.b = 0;
+  blend_alpha = -1;
+  stats = 0;
+  fixed_point = 0;
+  verify_fixed = 0;
+  cache_dir = NULL;
+
+  for (k = 0; k < OUTPUT_NUM_FORMATS; k++)
+    embed_formats[k] = 0;
+
+  for (k = 0; k < INVERSE_NUM_FORMATS; k++)
+    inverse_formats[k] = 0;
+
+  /* read command line arguments */
+  i = 1;
+
+  while (i < argc)
+  {
+    /* source (can be given more than once, or "all") */
     if (!strcmp(argv[i], "-s"))
     {
       i++;
@@ -696,24 +968,476 @@ int main(int argc, char *argv[])
         return 0;
       }
 
-      if (!strcmp("approx_nes", argv[i]))
-        G_source = SOURCE_APPROX_NES;
-      else if (!strcmp("approx_nes_rotated", argv[i]))
-        G_source = SOURCE_APPROX_NES_ROTATED;
-      else if (!strcmp("composite_08", argv[i]))
-        G_source = SOURCE_COMPOSITE_08;
-      else if (!strcmp("composite_16", argv[i]))
-        G_source = SOURCE_COMPOSITE_16;
-      else if (!strcmp("composite_16_rotated", argv[i]))
-        G_source = SOURCE_COMPOSITE_16_ROTATED;
-      else if (!strcmp("composite_32", argv[i]))
-        G_source = SOURCE_COMPOSITE_32;
+      /* all of the built-in sources */
+      if (!strcmp("all", argv[i]))
+      {
+        num_jobs = 0;
+
+        for (source = 0; source < SOURCE_NUM_SOURCES; source++)
+        {
+          if (!palette_source_is_custom(source))
+          {
+            jobs[num_jobs].source = source;
+            num_jobs += 1;
+          }
+        }
+      }
       else
       {
-        printf("Unknown source %s. Exiting...\n", argv[i]);
+        source = palette_source_from_name(argv[i]);
+
+        if (source < 0)
+        {
+          printf("Unknown source %s. Exiting...\n", argv[i]);
+          return 0;
+        }
+
+        /* skip sources that are already in the list */
+        for (k = 0; k < num_jobs; k++)
+        {
+          if (jobs[k].source == source)
+            break;
+        }
+
+        if (k == num_jobs)
+        {
+          jobs[num_jobs].source = source;
+          num_jobs += 1;
+        }
+      }
+
+      i++;
+    }
+    /* number of luma steps (custom composite palettes) */
+    else if (!strcmp(argv[i], "-n"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected number of luma steps. Exiting...\n");
+        return 0;
+      }
+
+      table_length = atoi(argv[i]);
+
+      i++;
+    }
+    /* number of hues (custom composite palettes) */
+    else if (!strcmp(argv[i], "-h"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected number of hues. Exiting...\n");
         return 0;
       }
 
+      num_hues = atoi(argv[i]);
+
+      i++;
+    }
+    /* signal source samples per subcarrier cycle */
+    else if (!strcmp(argv[i], "--signal-rate"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected samples per cycle. Exiting...\n");
+        return 0;
+      }
+
+      signal_rate = atoi(argv[i]);
+
+      if ((signal_rate < SIGNAL_MIN_RATE) || (signal_rate > SIGNAL_MAX_RATE))
+      {
+        printf("Samples per cycle must be from %d to %d. Exiting...\n",
+               SIGNAL_MIN_RATE, SIGNAL_MAX_RATE);
+        return 0;
+      }
+
+      i++;
+    }
+    /* signal source demodulation filter (box, hann) */
+    else if (!strcmp(argv[i], "--signal-filter"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected signal filter. Exiting...\n");
+        return 0;
+      }
+
+      signal_filter = signal_filter_from_name(argv[i]);
+
+      if (signal_filter < 0)
+      {
+        printf("Unknown signal filter %s. Exiting...\n", argv[i]);
+        return 0;
+      }
+
+      i++;
+    }
+    /* signal source filter length in samples */
+    else if (!strcmp(argv[i], "--signal-taps"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected filter length. Exiting...\n");
+        return 0;
+      }
+
+      signal_taps = atoi(argv[i]);
+
+      if ((signal_taps < 1) || (signal_taps > SIGNAL_MAX_TAPS))
+      {
+        printf("Filter length must be from 1 to %d. Exiting...\n",
+               SIGNAL_MAX_TAPS);
+        return 0;
+      }
+
+      i++;
+    }
+    /* number of nearest color index benchmark queries */
+    else if (!strcmp(argv[i], "-b"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected number of queries. Exiting...\n");
+        return 0;
+      }
+
+      num_queries = atoi(argv[i]);
+
+      i++;
+    }
+    /* input image to quantize */
+    else if (!strcmp(argv[i], "-q"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected input image filename. Exiting...\n");
+        return 0;
+      }
+
+      input_filename = argv[i];
+
+      i++;
+    }
+    /* output image filename */
+    else if (!strcmp(argv[i], "-o"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected output image filename. Exiting...\n");
+        return 0;
+      }
+
+      output_filename = argv[i];
+
+      i++;
+    }
+    /* dither mode (none, fs, atkinson, bayer) */
+    else if (!strcmp(argv[i], "-d"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected dither mode. Exiting...\n");
+        return 0;
+      }
+
+      dither = quantize_dither_from_name(argv[i]);
+
+      if (dither < 0)
+      {
+        printf("Unknown dither mode %s. Exiting...\n", argv[i]);
+        return 0;
+      }
+
+      i++;
+    }
+    /* filter the input image through the composite */
+    /* signal (instead of quantizing it)             */
+    else if (!strcmp(argv[i], "--ntsc"))
+    {
+      ntsc = 1;
+
+      i++;
+    }
+    /* frame number for the filter (moves the dot crawl) */
+    else if (!strcmp(argv[i], "--ntsc-frame"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected frame number. Exiting...\n");
+        return 0;
+      }
+
+      ntsc_frame = atoi(argv[i]);
+
+      if (ntsc_frame < 0)
+      {
+        printf("Frame number must not be negative. Exiting...\n");
+        return 0;
+      }
+
+      ntsc = 1;
+
+      i++;
+    }
+    /* 3d lut size (writes a .cube file) */
+    else if (!strcmp(argv[i], "-l"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected LUT size. Exiting...\n");
+        return 0;
+      }
+
+      lut_size = atoi(argv[i]);
+
+      if ((lut_size < LUT_MIN_SIZE) || (lut_size > LUT_MAX_SIZE))
+      {
+        printf("LUT size must be from %d to %d. Exiting...\n",
+               LUT_MIN_SIZE, LUT_MAX_SIZE);
+        return 0;
+      }
+
+      i++;
+    }
+    /* embed format (c, rgb, rgba, glsl, hlsl, pal; can be repeated) */
+    else if (!strcmp(argv[i], "-e"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected embed format. Exiting...\n");
+        return 0;
+      }
+
+      format = output_format_from_name(argv[i]);
+
+      if (format < 0)
+      {
+        printf("Unknown embed format %s. Exiting...\n", argv[i]);
+        return 0;
+      }
+
+      embed_formats[format] = 1;
+
+      i++;
+    }
+    /* inverse table format (888, 555, 565; can be repeated) */
+    else if (!strcmp(argv[i], "--inverse"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected inverse table format. Exiting...\n");
+        return 0;
+      }
+
+      format = inverse_format_from_name(argv[i]);
+
+      if (format < 0)
+      {
+        printf("Unknown inverse table format %s. Exiting...\n", argv[i]);
+        return 0;
+      }
+
+      inverse_formats[format] |= INVERSE_OUTPUT_BINARY;
+
+      i++;
+    }
+    /* inverse table written as a c array (555, 565; can be repeated) */
+    else if (!strcmp(argv[i], "--inverse-c"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected inverse table format. Exiting...\n");
+        return 0;
+      }
+
+      format = inverse_format_from_name(argv[i]);
+
+      if (format < 0)
+      {
+        printf("Unknown inverse table format %s. Exiting...\n", argv[i]);
+        return 0;
+      }
+
+      /* 16.7 million entries is too many to compile */
+      if (format == INVERSE_FORMAT_888)
+      {
+        printf("C arrays are only written for the 555 & 565 tables. ");
+        printf("Exiting...\n");
+        return 0;
+      }
+
+      inverse_formats[format] |= INVERSE_OUTPUT_C;
+
+      i++;
+    }
+    /* colormap light levels (writes a .cmap file) */
+    else if (!strcmp(argv[i], "--colormap"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected number of light levels. Exiting...\n");
+        return 0;
+      }
+
+      colormap_levels = atoi(argv[i]);
+
+      if ((colormap_levels < COLORMAP_MIN_LEVELS) ||
+          (colormap_levels > COLORMAP_MAX_LEVELS))
+      {
+        printf("Colormap levels must be from %d to %d. Exiting...\n",
+               COLORMAP_MIN_LEVELS, COLORMAP_MAX_LEVELS);
+        return 0;
+      }
+
+      i++;
+    }
+    /* colormap fog color (rrggbb in hex, black by default) */
+    else if (!strcmp(argv[i], "--colormap-fog"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected fog color. Exiting...\n");
+        return 0;
+      }
+
+      if ((strlen(argv[i]) != 6) ||
+          (strspn(argv[i], "0123456789abcdefABCDEF") != 6))
+      {
+        printf("Fog color must be 6 hex digits (rrggbb). Exiting...\n");
+        return 0;
+      }
+
+      value = strtol(argv[i], NULL, 16);
+
+      colormap_fog.r = (unsigned char) ((value >> 16) & 0xFF);
+      colormap_fog.g = (unsigned char) ((value >> 8) & 0xFF);
+      colormap_fog.b = (unsigned char) (value & 0xFF);
+
+      i++;
+    }
+    /* blend table alpha (percent of the row color; writes a .blend file) */
+    else if (!strcmp(argv[i], "--blend"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected blend alpha. Exiting...\n");
+        return 0;
+      }
+
+      blend_alpha = atoi(argv[i]);
+
+      if ((blend_alpha < BLEND_MIN_ALPHA) || (blend_alpha > BLEND_MAX_ALPHA))
+      {
+        printf("Blend alpha must be from %d to %d. Exiting...\n",
+               BLEND_MIN_ALPHA, BLEND_MAX_ALPHA);
+        return 0;
+      }
+
+      i++;
+    }
+    /* output file cache directory */
+    else if (!strcmp(argv[i], "--cache"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected cache directory. Exiting...\n");
+        return 0;
+      }
+
+      cache_dir = argv[i];
+
+      i++;
+    }
+    /* number of worker threads */
+    else if (!strcmp(argv[i], "-j"))
+    {
+      i++;
+
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected number of threads. Exiting...\n");
+        return 0;
+      }
+
+      parallel_set_num_threads(atoi(argv[i]));
+
+      i++;
+    }
+    /* per-phase timing & memory statistics */
+    else if (!strcmp(argv[i], "--stats"))
+    {
+      stats = 1;
+
+      i++;
+    }
+    /* integer (fixed-point) decode path */
+    else if (!strcmp(argv[i], "--fixed"))
+    {
+      fixed_point = 1;
+
+      i++;
+    }
+    /* compare the fixed-point & float decode paths */
+    else if (!strcmp(argv[i], "--verify-fixed"))
+    {
+      verify_fixed = 1;
+
       i++;
     }
     else
@@ -723,99 +1447,203 @@ int main(int argc, char *argv[])
     }
   }
 
-  /* generate output filenames */
-  if (G_source == SOURCE_APPROX_NES)
-    strncpy(output_base_filename, "approx_nes", 24);
-  else if (G_source == SOURCE_APPROX_NES_ROTATED)
-    strncpy(output_base_filename, "approx_nes_rotated", 24);
-  else if (G_source == SOURCE_COMPOSITE_08)
-    strncpy(output_base_filename, "composite_08", 24);
-  else if (G_source == SOURCE_COMPOSITE_16)
-    strncpy(output_base_filename, "composite_16", 24);
-  else if (G_source == SOURCE_COMPOSITE_16_ROTATED)
-    strncpy(output_base_filename, "composite_16_rotated", 24);
-  else if (G_source == SOURCE_COMPOSITE_32)
-    strncpy(output_base_filename, "composite_32", 24);
+  /* the filter does not use a palette, so no sources are generated */
+  if (ntsc)
+  {
+    if ((input_filename == NULL) || (output_filename == NULL))
+    {
+      printf("Filtering needs an input & output image (use -q & -o). ");
+      printf("Exiting...\n");
+      return 0;
+    }
 
-  strncpy(output_gpl_filename, output_base_filename, 256);
-  strncpy(output_tga_filename, output_base_filename, 256);
+    if (ntsc_filter_image(input_filename, output_filename, ntsc_frame,
+                          &nstats))
+    {
+      printf("Error filtering image %s.\n", input_filename);
+      return 0;
+    }
 
-  strncat(output_gpl_filename, ".gpl", 4);
-  strncat(output_tga_filename, ".tga", 4);
+    printf("Image filtered: %d x %d", nstats.width, nstats.height);
 
-  /* allocate palette array */
-  if ((G_source == SOURCE_APPROX_NES) || 
-      (G_source == SOURCE_APPROX_NES_ROTATED))
-  {
-    G_max_colors = 64;
-  }
-  else if ( (G_source == SOURCE_COMPOSITE_08) || 
-            (G_source == SOURCE_COMPOSITE_16) || 
-            (G_source == SOURCE_COMPOSITE_16_ROTATED))
-  {
-    G_max_colors = 256;
+    if (nstats.seconds > 0.0)
+    {
+      printf(", %.3f ms per frame (%.1f frames per second)",
+             nstats.seconds * 1000.0, 1.0 / nstats.seconds);
+    }
+
+    printf("\n");
+
+    return 0;
   }
-  else if (G_source == SOURCE_COMPOSITE_32)
+
+  /* if no source was given, use the default */
+  if (num_jobs == 0)
   {
-    G_max_colors = 1024;
+    jobs[0].source = SOURCE_APPROX_NES;
+    num_jobs = 1;
   }
-  else
+
+  /* quantizing needs exactly one palette & an output file */
+  if (input_filename != NULL)
   {
-    printf("Unable to determine max palette colors. Exiting...\n");
-    return 0;
-  }
+    if (num_jobs > 1)
+    {
+      printf("Only one source can be used when quantizing. Exiting...\n");
+      return 0;
+    }
 
-  G_colors_array = malloc(sizeof(color) * G_max_colors);
+    if (output_filename == NULL)
+    {
+      printf("No output image specified (use -o). Exiting...\n");
+      return 0;
+    }
+  }
 
-  if (G_colors_array == NULL)
+  /* set custom palette parameters */
+  for (k = 0; k < num_jobs; k++)
   {
-    printf("Error allocating palette array. Exiting...\n");
-    return 0;
+    jobs[k].table_length = table_length;
+    jobs[k].num_hues = num_hues;
+    jobs[k].signal_rate = signal_rate;
+    jobs[k].signal_filter = signal_filter;
+    jobs[k].signal_taps = signal_taps;
+    jobs[k].num_queries = num_queries;
+
+    jobs[k].input_filename = input_filename;
+    jobs[k].output_filename = output_filename;
+    jobs[k].dither = dither;
+    jobs[k].lut_size = lut_size;
+    jobs[k].colormap_levels = colormap_levels;
+    jobs[k].colormap_fog = colormap_fog;
+    jobs[k].blend_alpha = blend_alpha;
+    jobs[k].stats = stats;
+    jobs[k].reset_peak = (num_jobs == 1);
+    jobs[k].fixed_point = fixed_point;
+    jobs[k].verify_fixed = verify_fixed;
+
+    memcpy(jobs[k].embed_formats, embed_formats, sizeof(embed_formats));
+    memcpy(jobs[k].inverse_formats, inverse_formats,
+           sizeof(inverse_formats));
+
+    /* the nes palette is always written in the emulator .pal format */
+    if (jobs[k].source == SOURCE_NES)
+      jobs[k].embed_formats[OUTPUT_FORMAT_PAL] = 1;
+
+    jobs[k].cache_dir = cache_dir;
   }
 
-  /* set voltage table pointers */
-  if (set_voltage_table_pointers())
+  /* generate palettes & write output files */
+  if (parallel_run(num_jobs, generate_source, jobs))
   {
-    printf("Error setting voltage table pointers. Exiting...\n");
+    printf("Error starting worker threads. Exiting...\n");
     return 0;
   }
 
-  /* generate palette */
-  if ((G_source == SOURCE_APPROX_NES) || 
-      (G_source == SOURCE_APPROX_NES_ROTATED))
+  /* print color counts */
+  for (k = 0; k < num_jobs; k++)
   {
-    if (generate_palette_approx_nes())
+    if (jobs[k].status)
     {
-      printf("Error generating palette. Exiting...\n");
-      return 0;
+      printf("Error generating palette %s.\n",
+             palette_source_name(jobs[k].source));
     }
-  }
-  else if ( (G_source == SOURCE_COMPOSITE_08)          || 
-            (G_source == SOURCE_COMPOSITE_16)          || 
-            (G_source == SOURCE_COMPOSITE_16_ROTATED)  || 
-            (G_source == SOURCE_COMPOSITE_32))
-  {
-    if (generate_palette_composite())
+    else if (jobs[k].cache_hit && (num_jobs == 1))
+      printf("Palette restored from cache.\n");
+    else if (jobs[k].cache_hit)
+      printf("Palette %s restored from cache.\n", jobs[k].name);
+    else if (num_jobs == 1)
+      printf("Palette generated. Number of Colors: %d\n", jobs[k].num_colors);
+    else
     {
-      printf("Error generating palette. Exiting...\n");
-      return 0;
+      printf("Palette %s generated. Number of Colors: %d\n",
+             jobs[k].name, jobs[k].num_colors);
     }
-  }
 
-  /* print color count */
-  printf("Palette generated. Number of Colors: %d\n", G_num_colors);
+    /* print nearest color index benchmark */
+    if ((jobs[k].status == 0) && (jobs[k].num_queries > 0))
+    {
+      printf("Nearest color index (%s): ", jobs[k].name);
+      printf("%d candidates, built in %.3f ms, ",
+             jobs[k].index_candidates, jobs[k].index_seconds * 1000.0);
+
+      if (jobs[k].query_seconds > 0.0)
+      {
+        printf("%.2f million queries per second",
+               jobs[k].num_queries / jobs[k].query_seconds / 1.0e6);
+      }
+
+      printf(" (%d mismatches)\n", jobs[k].index_mismatches);
+    }
+
+    /* print quantization throughput */
+    if ((jobs[k].status == 0) && (jobs[k].input_filename != NULL))
+    {
+      printf("Image quantized: %d x %d",
+             jobs[k].qstats.width, jobs[k].qstats.height);
+
+      if (jobs[k].qstats.seconds > 0.0)
+      {
+        printf(", %.2f megapixels per second",
+               ((double) jobs[k].qstats.width * jobs[k].qstats.height) /
+               jobs[k].qstats.seconds / 1.0e6);
+      }
+
+      printf("\n");
+    }
+
+    /* print lut build time */
+    if ((jobs[k].status == 0) && (jobs[k].lut_size > 0) && !jobs[k].cache_hit)
+    {
+      printf("CUBE file written (%s): %d^3 entries in %.1f ms\n",
+             jobs[k].name, jobs[k].lut_size, jobs[k].lut_seconds * 1000.0);
+    }
+
+    /* print colormap build time */
+    if ((jobs[k].status == 0) && (jobs[k].colormap_levels > 0) &&
+        !jobs[k].cache_hit)
+    {
+      printf("Colormap written (%s): %d levels in %.1f ms\n",
+             jobs[k].name, jobs[k].colormap_levels,
+             jobs[k].colormap_seconds * 1000.0);
+    }
+
+    /* print blend table build time */
+    if ((jobs[k].status == 0) && (jobs[k].blend_alpha >= 0) &&
+        !jobs[k].cache_hit)
+    {
+      printf("Blend table written (%s): %d x %d entries in %.1f ms\n",
+             jobs[k].name, jobs[k].num_colors, jobs[k].num_colors,
+             jobs[k].blend_seconds * 1000.0);
+    }
+
+    /* print inverse table build time */
+    if ((jobs[k].status == 0) && !jobs[k].cache_hit &&
+        (jobs[k].inverse_seconds > 0.0))
+    {
+      printf("Inverse tables written (%s): built in %.1f ms\n",
+             jobs[k].name, jobs[k].inverse_seconds * 1000.0);
+    }
 
-  /* write output gpl file */
-  write_gpl_file(output_gpl_filename);
+    /* print fixed-point comparison */
+    if ((jobs[k].status == 0) && jobs[k].verify_fixed)
+    {
+      printf("Fixed-point check (%s): %d of %d colors differ",
+             jobs[k].name, jobs[k].verify_mismatches, jobs[k].num_colors);
+      printf(" (largest channel difference %d)\n",
+             jobs[k].verify_max_difference);
+    }
 
-  /* write output tga file */
-  write_tga_file(output_tga_filename);
+    /* print phase statistics */
+    if ((jobs[k].status == 0) && jobs[k].stats)
+      print_stats(&jobs[k], num_jobs);
+  }
 
-  /* free palette array */
-  if (G_colors_array != NULL)
+  /* fail if any palette was not fully written */
+  for (k = 0; k < num_jobs; k++)
   {
-    free(G_colors_array);
-    G_colors_array = NULL;
+    if (jobs[k].status)
+      return 1;
   }
 
   return 0;
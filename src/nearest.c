@@ -0,0 +1,497 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** nearest.c (nearest palette color lookup)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nearest.h"
+#include "palette.h"
+#include "parallel.h"
+
+/* batches at least this large are split across */
+/* threads, with this many pixels in each job   */
+#define NEAREST_PARALLEL_MIN_PIXELS 65536
+#define NEAREST_PARALLEL_JOB_PIXELS 16384
+
+typedef struct nearest_build
+{
+  nearest_index*  ni;
+
+  int*            unique;
+  int             num_unique;
+
+  int*            cell_threshold;
+  int*            cell_count;
+} nearest_build;
+
+typedef struct nearest_batch
+{
+  nearest_index*  ni;
+
+  color*          pixels;
+  int             num_pixels;
+  int*            indices;
+} nearest_batch;
+
+/*******************************************************************************
+** nearest_cell_bounds()
+*******************************************************************************/
+static void nearest_cell_bounds(int cell, int* lo, int* hi)
+{
+  int k;
+  int n;
+
+  /* channel order is r, g, b (r is the most significant) */
+  for (k = 2; k >= 0; k--)
+  {
+    n = cell & (NEAREST_GRID_SIZE - 1);
+
+    lo[k] = n << NEAREST_CELL_SHIFT;
+    hi[k] = lo[k] + (1 << NEAREST_CELL_SHIFT) - 1;
+
+    cell >>= NEAREST_GRID_BITS;
+  }
+}
+
+/*******************************************************************************
+** nearest_box_distances()
+*******************************************************************************/
+static void nearest_box_distances(color* c, int* lo, int* hi,
+                                  int* min_dist, int* max_dist)
+{
+  int v[3];
+  int k;
+
+  int near;
+  int far;
+
+  v[0] = c->r;
+  v[1] = c->g;
+  v[2] = c->b;
+
+  *min_dist = 0;
+  *max_dist = 0;
+
+  for (k = 0; k < 3; k++)
+  {
+    /* distance to the nearest point of the cell */
+    if (v[k] < lo[k])
+      near = lo[k] - v[k];
+    else if (v[k] > hi[k])
+      near = v[k] - hi[k];
+    else
+      near = 0;
+
+    /* distance to the farthest point of the cell */
+    if (v[k] - lo[k] > hi[k] - v[k])
+      far = v[k] - lo[k];
+    else
+      far = hi[k] - v[k];
+
+    *min_dist += near * near;
+    *max_dist += far * far;
+  }
+}
+
+/*******************************************************************************
+** nearest_count_cell()
+*******************************************************************************/
+static void nearest_count_cell(void* data, int cell)
+{
+  nearest_build*  nb;
+  color*          colors;
+
+  int lo[3];
+  int hi[3];
+
+  int min_dist;
+  int max_dist;
+
+  int threshold;
+  int count;
+  int k;
+
+  nb = (nearest_build*) data;
+  colors = nb->ni->colors;
+
+  nearest_cell_bounds(cell, lo, hi);
+
+  /* every point in the cell is within this distance of some color */
+  threshold = 3 * 256 * 256;
+
+  for (k = 0; k < nb->num_unique; k++)
+  {
+    nearest_box_distances(&colors[nb->unique[k]], lo, hi,
+                          &min_dist, &max_dist);
+
+    if (max_dist < threshold)
+      threshold = max_dist;
+  }
+
+  /* so only colors that come at least that close can be the nearest */
+  count = 0;
+
+  for (k = 0; k < nb->num_unique; k++)
+  {
+    nearest_box_distances(&colors[nb->unique[k]], lo, hi,
+                          &min_dist, &max_dist);
+
+    if (min_dist <= threshold)
+      count += 1;
+  }
+
+  nb->cell_threshold[cell] = threshold;
+  nb->cell_count[cell] = count;
+}
+
+/*******************************************************************************
+** nearest_fill_cell()
+*******************************************************************************/
+static void nearest_fill_cell(void* data, int cell)
+{
+  nearest_build*  nb;
+  nearest_index*  ni;
+
+  int lo[3];
+  int hi[3];
+
+  int min_dist;
+  int max_dist;
+
+  int index;
+  int pos;
+  int k;
+
+  nb = (nearest_build*) data;
+  ni = nb->ni;
+
+  nearest_cell_bounds(cell, lo, hi);
+
+  /* the candidates are stored in palette order, so that */
+  /* ties go to the lowest index (as in a linear search) */
+  pos = ni->cell_start[cell];
+
+  for (k = 0; k < nb->num_unique; k++)
+  {
+    index = nb->unique[k];
+
+    nearest_box_distances(&ni->colors[index], lo, hi, &min_dist, &max_dist);
+
+    if (min_dist <= nb->cell_threshold[cell])
+    {
+      ni->candidates[pos] = index;
+      ni->candidate_colors[pos] = ni->colors[index];
+      pos += 1;
+    }
+  }
+}
+
+/*******************************************************************************
+** nearest_index_init()
+*******************************************************************************/
+short int nearest_index_init(nearest_index* ni, color* colors, int num_colors)
+{
+  nearest_build nb;
+
+  unsigned char*  seen;
+  long            key;
+
+  int k;
+
+  if (ni == NULL)
+    return 1;
+
+  /* initialization */
+  ni->colors = colors;
+  ni->num_colors = num_colors;
+
+  ni->cell_start = NULL;
+  ni->candidates = NULL;
+  ni->candidate_colors = NULL;
+  ni->num_candidates = 0;
+
+  if ((colors == NULL) || (num_colors <= 0))
+  {
+    printf("Unable to build nearest color index: Palette is empty.\n");
+    return 1;
+  }
+
+  nb.ni = ni;
+  nb.num_unique = 0;
+
+  nb.unique = malloc(sizeof(int) * num_colors);
+  nb.cell_threshold = malloc(sizeof(int) * NEAREST_NUM_CELLS);
+  nb.cell_count = malloc(sizeof(int) * NEAREST_NUM_CELLS);
+  seen = calloc(1 << 21, 1);
+
+  ni->cell_start = malloc(sizeof(int) * (NEAREST_NUM_CELLS + 1));
+
+  if ((nb.unique == NULL)         ||
+      (nb.cell_threshold == NULL) ||
+      (nb.cell_count == NULL)     ||
+      (seen == NULL)              ||
+      (ni->cell_start == NULL))
+  {
+    printf("Unable to build nearest color index: Out of memory.\n");
+
+    free(nb.unique);
+    free(nb.cell_threshold);
+    free(nb.cell_count);
+    free(seen);
+
+    nearest_index_deinit(ni);
+    return 1;
+  }
+
+  /* skip repeated colors (the first one has the lowest index) */
+  for (k = 0; k < num_colors; k++)
+  {
+    key = (colors[k].r << 16) | (colors[k].g << 8) | colors[k].b;
+
+    if (seen[key >> 3] & (1 << (key & 7)))
+      continue;
+
+    seen[key >> 3] |= 1 << (key & 7);
+
+    nb.unique[nb.num_unique] = k;
+    nb.num_unique += 1;
+  }
+
+  free(seen);
+
+  /* count candidates in each cell */
+  if (parallel_run(NEAREST_NUM_CELLS, nearest_count_cell, &nb))
+  {
+    printf("Unable to build nearest color index: Unable to run jobs.\n");
+
+    free(nb.unique);
+    free(nb.cell_threshold);
+    free(nb.cell_count);
+
+    nearest_index_deinit(ni);
+    return 1;
+  }
+
+  ni->cell_start[0] = 0;
+
+  for (k = 0; k < NEAREST_NUM_CELLS; k++)
+    ni->cell_start[k + 1] = ni->cell_start[k] + nb.cell_count[k];
+
+  ni->num_candidates = ni->cell_start[NEAREST_NUM_CELLS];
+
+  /* fill in candidates */
+  ni->candidates = malloc(sizeof(int) * ni->num_candidates);
+  ni->candidate_colors = malloc(sizeof(color) * ni->num_candidates);
+
+  if ((ni->candidates == NULL) || (ni->candidate_colors == NULL))
+  {
+    printf("Unable to build nearest color index: Out of memory.\n");
+
+    free(nb.unique);
+    free(nb.cell_threshold);
+    free(nb.cell_count);
+
+    nearest_index_deinit(ni);
+    return 1;
+  }
+
+  if (parallel_run(NEAREST_NUM_CELLS, nearest_fill_cell, &nb))
+  {
+    printf("Unable to build nearest color index: Unable to run jobs.\n");
+
+    free(nb.unique);
+    free(nb.cell_threshold);
+    free(nb.cell_count);
+
+    nearest_index_deinit(ni);
+    return 1;
+  }
+
+  free(nb.unique);
+  free(nb.cell_threshold);
+  free(nb.cell_count);
+
+  return 0;
+}
+
+/*******************************************************************************
+** nearest_index_deinit()
+*******************************************************************************/
+void nearest_index_deinit(nearest_index* ni)
+{
+  if (ni == NULL)
+    return;
+
+  if (ni->cell_start != NULL)
+  {
+    free(ni->cell_start);
+    ni->cell_start = NULL;
+  }
+
+  if (ni->candidates != NULL)
+  {
+    free(ni->candidates);
+    ni->candidates = NULL;
+  }
+
+  if (ni->candidate_colors != NULL)
+  {
+    free(ni->candidate_colors);
+    ni->candidate_colors = NULL;
+  }
+
+  ni->colors = NULL;
+  ni->num_colors = 0;
+  ni->num_candidates = 0;
+}
+
+/*******************************************************************************
+** nearest_index_query()
+*******************************************************************************/
+int nearest_index_query(nearest_index* ni, int r, int g, int b)
+{
+  color*  c;
+
+  int     cell;
+  int     start;
+  int     end;
+  int     k;
+
+  int     dist;
+  int     best_dist;
+  int     best;
+
+  int     dr;
+  int     dg;
+  int     db;
+
+  cell =  ((r >> NEAREST_CELL_SHIFT) << (2 * NEAREST_GRID_BITS)) |
+          ((g >> NEAREST_CELL_SHIFT) << NEAREST_GRID_BITS) |
+          (b >> NEAREST_CELL_SHIFT);
+
+  start = ni->cell_start[cell];
+  end = ni->cell_start[cell + 1];
+
+  best = start;
+  best_dist = 3 * 256 * 256;
+
+  for (k = start; k < end; k++)
+  {
+    c = &ni->candidate_colors[k];
+
+    dr = c->r - r;
+    dg = c->g - g;
+    db = c->b - b;
+
+    dist = (dr * dr) + (dg * dg) + (db * db);
+
+    if (dist < best_dist)
+    {
+      best_dist = dist;
+      best = k;
+    }
+  }
+
+  return ni->candidates[best];
+}
+
+/*******************************************************************************
+** nearest_query_job()
+*******************************************************************************/
+static void nearest_query_job(void* data, int index)
+{
+  nearest_batch* batch;
+
+  int start;
+  int end;
+  int k;
+
+  batch = (nearest_batch*) data;
+
+  start = index * NEAREST_PARALLEL_JOB_PIXELS;
+  end = start + NEAREST_PARALLEL_JOB_PIXELS;
+
+  if (end > batch->num_pixels)
+    end = batch->num_pixels;
+
+  for (k = start; k < end; k++)
+  {
+    batch->indices[k] = nearest_index_query(batch->ni,  batch->pixels[k].r,
+                                                        batch->pixels[k].g,
+                                                        batch->pixels[k].b);
+  }
+}
+
+/*******************************************************************************
+** nearest_index_query_batch()
+*******************************************************************************/
+void nearest_index_query_batch(nearest_index* ni,
+                               color* pixels, int num_pixels, int* indices)
+{
+  nearest_batch batch;
+
+  int num_jobs;
+  int k;
+
+  batch.ni = ni;
+  batch.pixels = pixels;
+  batch.num_pixels = num_pixels;
+  batch.indices = indices;
+
+  num_jobs =  (num_pixels + NEAREST_PARALLEL_JOB_PIXELS - 1) /
+              NEAREST_PARALLEL_JOB_PIXELS;
+
+  /* large batches are split across threads (and the jobs */
+  /* are run here if the threads could not be started)    */
+  if ((num_pixels >= NEAREST_PARALLEL_MIN_PIXELS) &&
+      !parallel_run(num_jobs, nearest_query_job, &batch))
+  {
+    return;
+  }
+
+  for (k = 0; k < num_jobs; k++)
+    nearest_query_job(&batch, k);
+}
+
+/*******************************************************************************
+** nearest_search()
+*******************************************************************************/
+int nearest_search(color* colors, int num_colors, int r, int g, int b)
+{
+  int k;
+
+  int dist;
+  int best_dist;
+  int best;
+
+  int dr;
+  int dg;
+  int db;
+
+  /* linear search (used to check the index) */
+  best = 0;
+  best_dist = 3 * 256 * 256;
+
+  for (k = 0; k < num_colors; k++)
+  {
+    dr = colors[k].r - r;
+    dg = colors[k].g - g;
+    db = colors[k].b - b;
+
+    dist = (dr * dr) + (dg * dg) + (db * db);
+
+    if (dist < best_dist)
+    {
+      best_dist = dist;
+      best = k;
+    }
+  }
+
+  return best;
+}
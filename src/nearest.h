@@ -0,0 +1,44 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** nearest.h (nearest palette color lookup)
+*******************************************************************************/
+
+#ifndef NEAREST_H
+#define NEAREST_H
+
+#include "palette.h"
+
+/* the rgb cube is divided into a grid of cells,  */
+/* and each cell stores the palette colors that   */
+/* can be the nearest color to a point inside it  */
+#define NEAREST_GRID_BITS   4
+#define NEAREST_GRID_SIZE   (1 << NEAREST_GRID_BITS)
+#define NEAREST_CELL_SHIFT  (8 - NEAREST_GRID_BITS)
+#define NEAREST_NUM_CELLS   (NEAREST_GRID_SIZE * NEAREST_GRID_SIZE * NEAREST_GRID_SIZE)
+
+typedef struct nearest_index
+{
+  color*  colors;
+  int     num_colors;
+
+  int*    cell_start;
+  int*    candidates;
+  color*  candidate_colors;
+  int     num_candidates;
+} nearest_index;
+
+/* function declarations */
+short int nearest_index_init(nearest_index* ni, color* colors, int num_colors);
+void      nearest_index_deinit(nearest_index* ni);
+
+int       nearest_index_query(nearest_index* ni, int r, int g, int b);
+void      nearest_index_query_batch(nearest_index* ni,
+                                    color* pixels, int num_pixels,
+                                    int* indices);
+
+int       nearest_search(color* colors, int num_colors, int r, int g, int b);
+
+#endif
@@ -0,0 +1,206 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** nes.c (nes ppu palette)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "nes.h"
+#include "palette.h"
+#include "parallel.h"
+#include "yiq.h"
+
+/* the ppu outputs 12 samples per color subcarrier cycle; each */
+/* color is a square wave between the low & high voltages of   */
+/* its level, which is high when (hue + phase) % 12 < 6        */
+
+/* hue 0 stays high, hue 13 stays low, and hues 14 & 15 are    */
+/* black (the low voltage of level 1)                          */
+
+/* the emphasis bits attenuate the signal during the phases of */
+/* hues 12 (red), 4 (green) & 8 (blue), except for the blacks  */
+
+/* the voltages & attenuation are from the nesdev wiki  */
+/* (see the "NTSC video" page); the tables are relative */
+/* to black & white, so they are scaled back to volts   */
+/* before attenuating                                   */
+#define NES_BLACK_VOLTAGE 0.518
+#define NES_WHITE_VOLTAGE 1.962
+#define NES_ATTENUATION   0.746
+
+#define NES_NUM_PHASES    12
+
+/* the colorburst is hue 8, & a tv decodes the burst at 180 */
+/* degrees on the u axis; the references are set so that    */
+/* the hues land there in the i/q plane (which is the u/v   */
+/* plane, mirrored & turned by 33 degrees)                  */
+#define NES_REFERENCE_ANGLE 1.62315620435473203006  /* 93 degrees */
+
+#define NES_PI 3.14159265358979323846
+
+typedef struct nes_jobs
+{
+  palette_context*  pc;
+
+  double            i_weights[NES_NUM_PHASES];
+  double            q_weights[NES_NUM_PHASES];
+
+  /* per emphasis clamp counts */
+  int               num_clamped[NES_NUM_EMPHASIS];
+} nes_jobs;
+
+/*******************************************************************************
+** nes_in_phase()
+*******************************************************************************/
+static int nes_in_phase(int hue, int phase)
+{
+  return ((hue + phase) % NES_NUM_PHASES) < (NES_NUM_PHASES / 2);
+}
+
+/*******************************************************************************
+** nes_sample()
+*******************************************************************************/
+static double nes_sample(palette_context* pc, int index, int emphasis,
+                         int phase)
+{
+  int     hue;
+  int     level;
+
+  double  low;
+  double  high;
+  double  volts;
+
+  hue = index & 0x0F;
+  level = (index >> 4) & 0x03;
+
+  /* the blacks are always output at level 1 */
+  if (hue > 13)
+    level = 1;
+
+  low = pc->luma_table[level] - pc->saturation_table[level];
+  high = pc->luma_table[level] + pc->saturation_table[level];
+
+  if (hue == 0)
+    low = high;
+  else if (hue > 12)
+    high = low;
+
+  volts = NES_BLACK_VOLTAGE +
+          (nes_in_phase(hue, phase) ? high : low) *
+          (NES_WHITE_VOLTAGE - NES_BLACK_VOLTAGE);
+
+  /* emphasis */
+  if ((hue < 14) &&
+      (((emphasis & 1) && nes_in_phase(12, phase)) ||
+       ((emphasis & 2) && nes_in_phase(4, phase))  ||
+       ((emphasis & 4) && nes_in_phase(8, phase))))
+  {
+    volts *= NES_ATTENUATION;
+  }
+
+  return (volts - NES_BLACK_VOLTAGE) / (NES_WHITE_VOLTAGE - NES_BLACK_VOLTAGE);
+}
+
+/*******************************************************************************
+** generate_nes_emphasis()
+*******************************************************************************/
+static void generate_nes_emphasis(void* data, int emphasis)
+{
+  nes_jobs*         jobs;
+  palette_context*  pc;
+
+  float   y[NES_NUM_COLORS];
+  float   i[NES_NUM_COLORS];
+  float   q[NES_NUM_COLORS];
+
+  double  samples[NES_NUM_PHASES];
+  double  sum_y;
+  double  sum_i;
+  double  sum_q;
+
+  int     index;
+  int     p;
+
+  jobs = (nes_jobs*) data;
+  pc = jobs->pc;
+
+  for (index = 0; index < NES_NUM_COLORS; index++)
+  {
+    sum_y = 0.0;
+
+    for (p = 0; p < NES_NUM_PHASES; p++)
+    {
+      samples[p] = nes_sample(pc, index, emphasis, p);
+      sum_y += samples[p];
+    }
+
+    sum_y /= NES_NUM_PHASES;
+
+    /* the references sum to 0, so only the part of the signal */
+    /* that varies is mixed (a constant signal comes out grey  */
+    /* exactly, rather than with rounding noise)               */
+    sum_i = 0.0;
+    sum_q = 0.0;
+
+    for (p = 0; p < NES_NUM_PHASES; p++)
+    {
+      sum_i += (samples[p] - sum_y) * jobs->i_weights[p];
+      sum_q += (samples[p] - sum_y) * jobs->q_weights[p];
+    }
+
+    y[index] = (float) sum_y;
+    i[index] = (float) sum_i;
+    q[index] = (float) sum_q;
+  }
+
+  jobs->num_clamped[emphasis] =
+    yiq_convert_colors( y, i, q, NES_NUM_COLORS,
+                        &pc->colors_array[pc->num_colors +
+                                          emphasis * NES_NUM_COLORS]);
+}
+
+/*******************************************************************************
+** generate_palette_nes()
+*******************************************************************************/
+short int generate_palette_nes(palette_context* pc)
+{
+  nes_jobs jobs;
+
+  double angle;
+
+  int k;
+
+  if (pc->num_colors + NES_NUM_COLORS * NES_NUM_EMPHASIS > pc->max_colors)
+  {
+    printf("Unable to add colors: Colors array is filled.\n");
+    return 1;
+  }
+
+  /* subcarrier references, at the middle of each sample */
+  /* (mixing halves the amplitude, so i & q are doubled) */
+  jobs.pc = pc;
+
+  for (k = 0; k < NES_NUM_PHASES; k++)
+  {
+    angle = ((2.0 * NES_PI * (k + 0.5)) / NES_NUM_PHASES) + NES_REFERENCE_ANGLE;
+
+    jobs.i_weights[k] = (2.0 * cos(angle)) / NES_NUM_PHASES;
+    jobs.q_weights[k] = (2.0 * sin(angle)) / NES_NUM_PHASES;
+  }
+
+  /* one job per emphasis setting */
+  if (parallel_run(NES_NUM_EMPHASIS, generate_nes_emphasis, &jobs))
+    return 1;
+
+  for (k = 0; k < NES_NUM_EMPHASIS; k++)
+    pc->num_clamped += jobs.num_clamped[k];
+
+  pc->num_colors += NES_NUM_COLORS * NES_NUM_EMPHASIS;
+
+  return 0;
+}
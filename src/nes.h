@@ -0,0 +1,21 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** nes.h (nes ppu palette)
+*******************************************************************************/
+
+#ifndef NES_H
+#define NES_H
+
+#include "palette.h"
+
+/* 64 colors (4 levels x 16 hues) for each of the 8 emphasis settings */
+#define NES_NUM_COLORS      64
+#define NES_NUM_EMPHASIS    8
+
+/* function declarations */
+short int generate_palette_nes(palette_context* pc);
+
+#endif
@@ -0,0 +1,407 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** ntsc.c (composite artifact filter for image frames)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "image.h"
+#include "ntsc.h"
+#include "palette.h"
+#include "parallel.h"
+#include "timer.h"
+#include "yiq.h"
+
+/* each row is encoded the way the composite palettes model a  */
+/* color: the luma plus a subcarrier with the chroma as its    */
+/* amplitude & angle; the signal is sampled 12 times per cycle */
+/* and each pixel lasts 8 samples (2/3 of a cycle, the timing  */
+/* of the 256 pixel wide consoles)                             */
+
+/* the row is then decoded like a tv without a comb filter: a  */
+/* short low-pass filter gives the luma (leaving some of the   */
+/* subcarrier in it, which shows up as dots), and mixing with  */
+/* the subcarrier before a longer filter gives i & q (picking  */
+/* up the luma edges, which shows up as color fringes)         */
+
+/* every line starts 1/3 of a cycle later than the one above   */
+/* it, and every frame 1/3 of a cycle later than the last, so  */
+/* the dots move from frame to frame (dot crawl)               */
+#define NTSC_SAMPLES_PER_CYCLE  12
+#define NTSC_SAMPLES_PER_PIXEL  8
+#define NTSC_LINE_PHASE         4
+
+/* the filters are boxes, taken from running sums of the row; */
+/* the luma covers one pixel, and i & q two subcarrier cycles */
+#define NTSC_LUMA_TAPS    8
+#define NTSC_CHROMA_TAPS  24
+
+/* rows are filtered in jobs of this many rows, and */
+/* images are read in bands of about this many pixels */
+#define NTSC_JOB_ROWS     8
+#define NTSC_BAND_PIXELS  (1 << 20)
+
+#define NTSC_PI 3.14159265358979323846
+
+typedef struct ntsc_jobs
+{
+  color*    input;
+  color*    output;
+
+  int       width;
+  int       num_rows;
+  int       first_line;
+  int       top_down;
+  int       frame;
+
+  /* subcarrier references, at the middle of each sample */
+  double    sin_table[NTSC_SAMPLES_PER_CYCLE];
+  double    cos_table[NTSC_SAMPLES_PER_CYCLE];
+
+  short int*  status;
+} ntsc_jobs;
+
+/*******************************************************************************
+** ntsc_filter_row()
+*******************************************************************************/
+static void ntsc_filter_row(ntsc_jobs* jobs, int row, double* sums,
+                            float* yiq)
+{
+  color*  pixels;
+
+  double* sum_y;
+  double* sum_i;
+  double* sum_q;
+
+  float*  y_row;
+  float*  i_row;
+  float*  q_row;
+
+  double  y;
+  double  i;
+  double  q;
+  double  s;
+
+  int     num_samples;
+  int     line;
+  int     phase;
+  int     center;
+  int     low;
+  int     high;
+  int     n;
+  int     x;
+  int     k;
+
+  pixels = &jobs->input[row * jobs->width];
+
+  num_samples = NTSC_SAMPLES_PER_PIXEL * jobs->width;
+
+  sum_y = sums;
+  sum_i = sum_y + num_samples + 1;
+  sum_q = sum_i + num_samples + 1;
+
+  y_row = yiq;
+  i_row = y_row + jobs->width;
+  q_row = i_row + jobs->width;
+
+  /* phase of the first sample in the row (the line */
+  /* phases count down the screen, whichever order  */
+  /* the rows are in)                               */
+  if (jobs->top_down)
+    line = jobs->first_line + row;
+  else
+    line = jobs->first_line - row;
+
+  phase = ((line % NTSC_SAMPLES_PER_CYCLE) +
+           (jobs->frame % NTSC_SAMPLES_PER_CYCLE)) * NTSC_LINE_PHASE;
+  phase %= NTSC_SAMPLES_PER_CYCLE;
+
+  /* encode, keeping running sums of the signal and */
+  /* of the signal mixed with each reference        */
+  sum_y[0] = 0.0;
+  sum_i[0] = 0.0;
+  sum_q[0] = 0.0;
+
+  n = 0;
+
+  for (x = 0; x < jobs->width; x++)
+  {
+    y = ( 0.299 * pixels[x].r + 0.587 * pixels[x].g +
+          0.114 * pixels[x].b) / 255.0;
+    i = ( 0.596 * pixels[x].r - 0.274 * pixels[x].g -
+          0.322 * pixels[x].b) / 255.0;
+    q = ( 0.211 * pixels[x].r - 0.523 * pixels[x].g +
+          0.312 * pixels[x].b) / 255.0;
+
+    for (k = 0; k < NTSC_SAMPLES_PER_PIXEL; k++)
+    {
+      s = y + i * jobs->sin_table[phase] - q * jobs->cos_table[phase];
+
+      sum_y[n + 1] = sum_y[n] + s;
+      sum_i[n + 1] = sum_i[n] + s * jobs->sin_table[phase];
+      sum_q[n + 1] = sum_q[n] + s * jobs->cos_table[phase];
+
+      n += 1;
+      phase += 1;
+
+      if (phase == NTSC_SAMPLES_PER_CYCLE)
+        phase = 0;
+    }
+  }
+
+  /* decode at the middle of each pixel (the signal is */
+  /* black past the ends of the row, where the sums    */
+  /* stop changing)                                    */
+  for (x = 0; x < jobs->width; x++)
+  {
+    center = NTSC_SAMPLES_PER_PIXEL * x + NTSC_SAMPLES_PER_PIXEL / 2;
+
+    low = center - NTSC_LUMA_TAPS / 2;
+    high = center + NTSC_LUMA_TAPS / 2;
+
+    if (low < 0)
+      low = 0;
+    if (high > num_samples)
+      high = num_samples;
+
+    y_row[x] = (float) ((sum_y[high] - sum_y[low]) / NTSC_LUMA_TAPS);
+
+    /* mixing halves the amplitude, so i & q are doubled */
+    low = center - NTSC_CHROMA_TAPS / 2;
+    high = center + NTSC_CHROMA_TAPS / 2;
+
+    if (low < 0)
+      low = 0;
+    if (high > num_samples)
+      high = num_samples;
+
+    i_row[x] = (float) ((2.0 / NTSC_CHROMA_TAPS) * (sum_i[high] - sum_i[low]));
+    q_row[x] = (float) ((-2.0 / NTSC_CHROMA_TAPS) * (sum_q[high] - sum_q[low]));
+  }
+
+  yiq_convert_colors( y_row, i_row, q_row, jobs->width,
+                      &jobs->output[row * jobs->width]);
+}
+
+/*******************************************************************************
+** ntsc_filter_job()
+*******************************************************************************/
+static void ntsc_filter_job(void* data, int index)
+{
+  ntsc_jobs*  jobs;
+
+  double*     sums;
+  float*      yiq;
+
+  int         row;
+  int         end;
+
+  jobs = (ntsc_jobs*) data;
+
+  /* each job has its own running sums & y, i & q rows */
+  sums = malloc(sizeof(double) * 3 *
+                (NTSC_SAMPLES_PER_PIXEL * jobs->width + 1));
+  yiq = malloc(sizeof(float) * 3 * jobs->width);
+
+  if ((sums == NULL) || (yiq == NULL))
+  {
+    free(sums);
+    free(yiq);
+    jobs->status[index] = 1;
+    return;
+  }
+
+  row = index * NTSC_JOB_ROWS;
+  end = row + NTSC_JOB_ROWS;
+
+  if (end > jobs->num_rows)
+    end = jobs->num_rows;
+
+  for (; row < end; row++)
+    ntsc_filter_row(jobs, row, sums, yiq);
+
+  free(sums);
+  free(yiq);
+
+  jobs->status[index] = 0;
+}
+
+/*******************************************************************************
+** ntsc_filter_rows()
+*******************************************************************************/
+short int ntsc_filter_rows( color* input, color* output,
+                            int width, int num_rows,
+                            int first_line, int top_down, int frame)
+{
+  ntsc_jobs jobs;
+
+  double angle;
+
+  int num_jobs;
+  int k;
+
+  if ((input == NULL) || (output == NULL) || (width <= 0) ||
+      (num_rows <= 0) || (frame < 0) || (first_line < 0) ||
+      (!top_down && (first_line < num_rows - 1)))
+  {
+    printf("Filter image failed: Invalid frame.\n");
+    return 1;
+  }
+
+  jobs.input = input;
+  jobs.output = output;
+  jobs.width = width;
+  jobs.num_rows = num_rows;
+  jobs.first_line = first_line;
+  jobs.top_down = top_down;
+  jobs.frame = frame;
+
+  for (k = 0; k < NTSC_SAMPLES_PER_CYCLE; k++)
+  {
+    angle = (2.0 * NTSC_PI * (k + 0.5)) / NTSC_SAMPLES_PER_CYCLE;
+
+    jobs.sin_table[k] = sin(angle);
+    jobs.cos_table[k] = cos(angle);
+  }
+
+  num_jobs = (num_rows + NTSC_JOB_ROWS - 1) / NTSC_JOB_ROWS;
+
+  jobs.status = malloc(sizeof(short int) * num_jobs);
+
+  if (jobs.status == NULL)
+  {
+    printf("Filter image failed: Out of memory.\n");
+    return 1;
+  }
+
+  /* the rows have no dependence on each other */
+  if (parallel_run(num_jobs, ntsc_filter_job, &jobs))
+  {
+    free(jobs.status);
+    return 1;
+  }
+
+  for (k = 0; k < num_jobs; k++)
+  {
+    if (jobs.status[k])
+    {
+      printf("Filter image failed: Out of memory.\n");
+      free(jobs.status);
+      return 1;
+    }
+  }
+
+  free(jobs.status);
+
+  return 0;
+}
+
+/*******************************************************************************
+** ntsc_filter_image()
+*******************************************************************************/
+short int ntsc_filter_image(char* input_filename, char* output_filename,
+                            int frame, ntsc_stats* stats)
+{
+  image_reader  ir;
+  image_writer  iw;
+
+  color*  input;
+  color*  output;
+
+  int     band_rows;
+  int     num_rows;
+  int     row;
+
+  double  seconds;
+  double  start;
+
+  /* open input image */
+  if (image_reader_open(&ir, input_filename))
+    return 1;
+
+  /* open output image */
+  if (image_writer_open_rgb(&iw, output_filename,
+                            ir.width, ir.height, ir.top_down))
+  {
+    image_reader_close(&ir);
+    return 1;
+  }
+
+  /* allocate band buffers */
+  band_rows = NTSC_BAND_PIXELS / ir.width;
+
+  if (band_rows < 1)
+    band_rows = 1;
+  else if (band_rows > ir.height)
+    band_rows = ir.height;
+
+  input = malloc(sizeof(color) * ir.width * band_rows);
+  output = malloc(sizeof(color) * ir.width * band_rows);
+
+  if ((input == NULL) || (output == NULL))
+  {
+    printf("Filter image failed: Out of memory.\n");
+
+    free(input);
+    free(output);
+
+    image_reader_close(&ir);
+    image_writer_close(&iw);
+    return 1;
+  }
+
+  /* read a band, filter its rows across threads, and write it out */
+  seconds = 0.0;
+
+  for (row = 0; row < ir.height; row += num_rows)
+  {
+    num_rows = band_rows;
+
+    if (row + num_rows > ir.height)
+      num_rows = ir.height - row;
+
+    if (image_read_rows(&ir, input, num_rows))
+      break;
+
+    start = timer_seconds();
+
+    /* bottom up images start at the last line of the screen */
+    if (ntsc_filter_rows( input, output, ir.width, num_rows,
+                          ir.top_down ? row : (ir.height - 1 - row),
+                          ir.top_down, frame))
+    {
+      break;
+    }
+
+    seconds += timer_seconds() - start;
+
+    if (image_write_rows(&iw, output, num_rows))
+      break;
+  }
+
+  free(input);
+  free(output);
+
+  image_reader_close(&ir);
+
+  if (image_writer_close(&iw) || (row < ir.height))
+  {
+    printf("Filter image failed: Unable to finish output image.\n");
+    return 1;
+  }
+
+  /* fill in stats */
+  if (stats != NULL)
+  {
+    stats->width = ir.width;
+    stats->height = ir.height;
+    stats->seconds = seconds;
+  }
+
+  return 0;
+}
@@ -0,0 +1,34 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** ntsc.h (composite artifact filter for image frames)
+*******************************************************************************/
+
+#ifndef NTSC_H
+#define NTSC_H
+
+#include "palette.h"
+
+typedef struct ntsc_stats
+{
+  int     width;
+  int     height;
+
+  /* time spent filtering (not reading or writing the image) */
+  double  seconds;
+} ntsc_stats;
+
+/* function declarations */
+
+/* first_line is the screen line of the first row; the rows */
+/* go up the screen from there if top_down is 0             */
+short int ntsc_filter_rows( color* input, color* output,
+                            int width, int num_rows,
+                            int first_line, int top_down, int frame);
+
+short int ntsc_filter_image(char* input_filename, char* output_filename,
+                            int frame, ntsc_stats* stats);
+
+#endif
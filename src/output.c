@@ -0,0 +1,800 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** output.c (palette file output)
+*******************************************************************************/
+
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200112L
+#define OUTPUT_HAVE_POSIX
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(OUTPUT_HAVE_POSIX)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include "output.h"
+#include "palette.h"
+
+/* each output file is assembled in memory, with room for  */
+/* the header text plus the longest possible line per color */
+#define OUTPUT_MAX_HEADER_LENGTH  1024
+#define OUTPUT_COMPARE_SIZE       (1 << 20)
+
+#define GPL_MAX_LINE_LENGTH       28
+#define C_HEADER_MAX_LINE_LENGTH  20
+#define SHADER_MAX_LINE_LENGTH    40
+
+/* embed format names (used for the command line) & file extensions */
+static char* S_output_format_names[OUTPUT_NUM_FORMATS] =
+  { "c",
+    "rgb",
+    "rgba",
+    "glsl",
+    "hlsl",
+    "pal"
+  };
+
+static char* S_output_format_extensions[OUTPUT_NUM_FORMATS] =
+  { ".h",
+    ".rgb",
+    ".rgba",
+    ".glsl",
+    ".hlsl",
+    ".pal"
+  };
+
+/*******************************************************************************
+** output_file_matches()
+*******************************************************************************/
+static int output_file_matches(char* filename, char* data, long num_bytes)
+{
+  FILE* fp_in;
+  char* buffer;
+  long  offset;
+  size_t n;
+  int   matches;
+
+#if defined(OUTPUT_HAVE_POSIX)
+  struct stat st;
+
+  void* mapped;
+  int   fd;
+
+  /* compare against a read-only map of the existing file */
+  fd = open(filename, O_RDONLY);
+
+  if (fd < 0)
+    return 0;
+
+  if (fstat(fd, &st) || (st.st_size != (off_t) num_bytes))
+  {
+    close(fd);
+    return 0;
+  }
+
+  if (num_bytes == 0)
+  {
+    close(fd);
+    return 1;
+  }
+
+  mapped = mmap(NULL, num_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  if (mapped != MAP_FAILED)
+  {
+    matches = !memcmp(mapped, data, num_bytes);
+
+    munmap(mapped, num_bytes);
+    close(fd);
+
+    return matches;
+  }
+
+  /* if mapping fails, fall back to reading the file below */
+  close(fd);
+#endif
+
+  fp_in = fopen(filename, "rb");
+
+  if (fp_in == NULL)
+    return 0;
+
+  buffer = malloc(OUTPUT_COMPARE_SIZE);
+
+  if (buffer == NULL)
+  {
+    fclose(fp_in);
+    return 0;
+  }
+
+  /* compare a chunk at a time (the file must also end with the data) */
+  offset = 0;
+  matches = 1;
+
+  while (matches && ((n = fread(buffer, 1, OUTPUT_COMPARE_SIZE, fp_in)) > 0))
+  {
+    if ((offset + (long) n > num_bytes) || memcmp(buffer, data + offset, n))
+      matches = 0;
+
+    offset += n;
+  }
+
+  if (ferror(fp_in) || (offset != num_bytes))
+    matches = 0;
+
+  fclose(fp_in);
+  free(buffer);
+
+  return matches;
+}
+
+/*******************************************************************************
+** replace_output_file()
+*******************************************************************************/
+short int replace_output_file(char* filename, char* data, long num_bytes)
+{
+  FILE* fp_out;
+
+  char* temp;
+
+  /* leave the file (& its modification time) alone if nothing changed */
+  if (output_file_matches(filename, data, num_bytes))
+    return 0;
+
+  /* write to a temporary file next to the output, then rename it */
+  /* into place, so that readers never see a partial file         */
+  temp = malloc(strlen(filename) + 32);
+
+  if (temp == NULL)
+    return 1;
+
+#if defined(OUTPUT_HAVE_POSIX)
+  sprintf(temp, "%s.%ld.tmp", filename, (long) getpid());
+#else
+  sprintf(temp, "%s.tmp", filename);
+#endif
+
+  fp_out = fopen(temp, "wb");
+
+  if (fp_out == NULL)
+  {
+    free(temp);
+    return 1;
+  }
+
+  if (fwrite(data, 1, num_bytes, fp_out) < (size_t) num_bytes)
+  {
+    fclose(fp_out);
+    remove(temp);
+    free(temp);
+    return 1;
+  }
+
+  if (fclose(fp_out))
+  {
+    remove(temp);
+    free(temp);
+    return 1;
+  }
+
+#if defined(OUTPUT_HAVE_POSIX)
+  /* the rename replaces the old file atomically, so if it */
+  /* fails, the old file is still there & is left alone    */
+  if (rename(temp, filename))
+  {
+    remove(temp);
+    free(temp);
+    return 1;
+  }
+#else
+  /* some systems will not rename over an existing file */
+  if (rename(temp, filename))
+  {
+    remove(filename);
+
+    if (rename(temp, filename))
+    {
+      remove(temp);
+      free(temp);
+      return 1;
+    }
+  }
+#endif
+
+  free(temp);
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_gpl_file()
+*******************************************************************************/
+short int write_gpl_file(palette_context* pc, char* filename)
+{
+  int   color_index;
+
+  unsigned char r;
+  unsigned char g;
+  unsigned char b;
+
+  char  padded[256][3];
+  char  digits[256][3];
+  int   num_digits[256];
+
+  char* buffer;
+  char* p;
+
+  int   k;
+
+  /* check that output gpl file was given */
+  if (filename == NULL)
+  {
+    printf("No output GPL file specified. Exiting...\n");
+    return 1;
+  }
+
+  /* build digit tables (right aligned in 3 columns, and unpadded; */
+  /* the unpadded digits are copied 3 bytes at a time, so the rest */
+  /* of each entry is filled in, and then written over)            */
+  for (k = 0; k < 256; k++)
+  {
+    padded[k][0] = (k < 100) ? ' ' : '0' + (k / 100);
+    padded[k][1] = (k < 10) ? ' ' : '0' + ((k / 10) % 10);
+    padded[k][2] = '0' + (k % 10);
+
+    num_digits[k] = (k < 10) ? 1 : ((k < 100) ? 2 : 3);
+
+    memset(digits[k], ' ', 3);
+    memcpy(digits[k], &padded[k][3 - num_digits[k]], num_digits[k]);
+  }
+
+  buffer = malloc(OUTPUT_MAX_HEADER_LENGTH +
+                  (long) GPL_MAX_LINE_LENGTH * pc->num_colors);
+
+  if (buffer == NULL)
+  {
+    printf("Unable to allocate GPL output buffer. Exiting...\n");
+    return 1;
+  }
+
+  /* header info */
+  p = buffer;
+
+  p += sprintf(p, "GIMP Palette\n");
+
+  p += sprintf(p, "Name: %s\n", pc->title);
+
+  p += sprintf(p, "Columns: 16\n\n");
+
+  /* palette colors (each line is "rrr ggg bbb\t(r, g, b)") */
+  for (color_index = 0; color_index < pc->num_colors; color_index++)
+  {
+    r = pc->colors_array[color_index].r;
+    g = pc->colors_array[color_index].g;
+    b = pc->colors_array[color_index].b;
+
+    memcpy(p, padded[r], 3);
+    p[3] = ' ';
+    memcpy(p + 4, padded[g], 3);
+    p[7] = ' ';
+    memcpy(p + 8, padded[b], 3);
+    p[11] = '\t';
+    p[12] = '(';
+    p += 13;
+
+    memcpy(p, digits[r], 3);
+    p += num_digits[r];
+    p[0] = ',';
+    p[1] = ' ';
+    p += 2;
+
+    memcpy(p, digits[g], 3);
+    p += num_digits[g];
+    p[0] = ',';
+    p[1] = ' ';
+    p += 2;
+
+    memcpy(p, digits[b], 3);
+    p += num_digits[b];
+    p[0] = ')';
+    p[1] = '\n';
+    p += 2;
+  }
+
+  /* write out the file (if it changed) */
+  if (replace_output_file(filename, buffer, p - buffer))
+  {
+    printf("Unable to write output GPL file. Exiting...\n");
+    free(buffer);
+    return 1;
+  }
+
+  free(buffer);
+
+  return 0;
+}
+
+#define TGA_HEADER_SIZE 18
+
+/*******************************************************************************
+** fill_tga_data()
+*******************************************************************************/
+static void fill_tga_data(palette_context* pc, unsigned char* data,
+                          int image_w, int image_h)
+{
+  unsigned char* p;
+
+  int color_index;
+  int num_pixels;
+
+  num_pixels = image_w * image_h;
+
+  /* header (multi-byte fields are little endian) */
+  data[0] = 0;                          /* image id field length      */
+  data[1] = 0;                          /* color map type             */
+  data[2] = 2;                          /* image type (truecolor)     */
+  data[3] = 0;                          /* color map specification    */
+  data[4] = 0;
+  data[5] = 0;
+  data[6] = 0;
+  data[7] = 0;
+  data[8] = 0;                          /* x origin                   */
+  data[9] = 0;
+  data[10] = 0;                         /* y origin                   */
+  data[11] = 0;
+  data[12] = image_w & 0xFF;            /* image width                */
+  data[13] = (image_w >> 8) & 0xFF;
+  data[14] = image_h & 0xFF;            /* image height               */
+  data[15] = (image_h >> 8) & 0xFF;
+  data[16] = 24;                        /* pixel bpp                  */
+  data[17] = 0x20;                      /* image descriptor (top-down)*/
+
+  /* palette colors (bgr) */
+  p = &data[TGA_HEADER_SIZE];
+
+  for (color_index = 0; color_index < pc->num_colors; color_index++)
+  {
+    p[0] = pc->colors_array[color_index].b;
+    p[1] = pc->colors_array[color_index].g;
+    p[2] = pc->colors_array[color_index].r;
+
+    p += 3;
+  }
+
+  /* fill remaining spaces with zeroes */
+  if (num_pixels > pc->num_colors)
+    memset(p, 0, 3 * (num_pixels - pc->num_colors));
+}
+
+/*******************************************************************************
+** write_tga_file()
+*******************************************************************************/
+short int write_tga_file(palette_context* pc, char* filename)
+{
+  unsigned char*  data;
+
+  int             image_w;
+  int             image_h;
+
+  long            num_bytes;
+
+  /* make sure the colors fit in 1024 x 65535 pixels */
+  if (pc->num_colors > 1024 * 65535)
+  {
+    printf("Write TGA file failed: Number of colors > 1024 x 65535.\n");
+    return 1;
+  }
+
+  /* make sure filename is valid */
+  if (filename == NULL)
+  {
+    printf("Write TGA file failed: No filename specified.\n");
+    return 1;
+  }
+
+  /* determine image size */
+  if (pc->num_colors <= 64)
+    image_w = 64;
+  else if (pc->num_colors <= 256)
+    image_w = 256;
+  else
+    image_w = 1024;
+
+  /* palettes larger than 1024 colors are split into rows */
+  if (pc->num_colors <= 1024)
+    image_h = 1;
+  else
+    image_h = (pc->num_colors + image_w - 1) / image_w;
+
+  num_bytes = TGA_HEADER_SIZE + (3L * image_w * image_h);
+
+  /* assemble header & pixels in one buffer */
+  data = malloc(num_bytes);
+
+  if (data == NULL)
+  {
+    printf("Write TGA file failed: Out of memory.\n");
+    return 1;
+  }
+
+  fill_tga_data(pc, data, image_w, image_h);
+
+  /* write it out (if it changed) */
+  if (replace_output_file(filename, (char*) data, num_bytes))
+  {
+    printf("Write TGA file failed: Unable to write output file.\n");
+    free(data);
+    return 1;
+  }
+
+  free(data);
+
+  return 0;
+}
+
+/*******************************************************************************
+** output_format_from_name()
+*******************************************************************************/
+int output_format_from_name(char* name)
+{
+  int k;
+
+  if (name == NULL)
+    return -1;
+
+  for (k = 0; k < OUTPUT_NUM_FORMATS; k++)
+  {
+    if (!strcmp(S_output_format_names[k], name))
+      return k;
+  }
+
+  return -1;
+}
+
+/*******************************************************************************
+** output_format_extension()
+*******************************************************************************/
+char* output_format_extension(int format)
+{
+  if ((format < 0) || (format >= OUTPUT_NUM_FORMATS))
+    return NULL;
+
+  return S_output_format_extensions[format];
+}
+
+/*******************************************************************************
+** write_c_header_file()
+*******************************************************************************/
+short int write_c_header_file(palette_context* pc, char* filename)
+{
+  char  upper_name[PALETTE_NAME_LENGTH];
+  char  hex[256][4];
+
+  char* buffer;
+  char* p;
+
+  color* c;
+
+  int   color_index;
+  int   k;
+
+  /* make sure filename is valid */
+  if (filename == NULL)
+  {
+    printf("Write C header failed: No filename specified.\n");
+    return 1;
+  }
+
+  /* build hex table ("0xhh") */
+  for (k = 0; k < 256; k++)
+  {
+    hex[k][0] = '0';
+    hex[k][1] = 'x';
+    hex[k][2] = "0123456789abcdef"[k >> 4];
+    hex[k][3] = "0123456789abcdef"[k & 15];
+  }
+
+  /* the include guard & defines use the upper case name */
+  for (k = 0; (pc->name[k] != '\0') && (k < PALETTE_NAME_LENGTH - 1); k++)
+  {
+    if ((pc->name[k] >= 'a') && (pc->name[k] <= 'z'))
+      upper_name[k] = pc->name[k] - 'a' + 'A';
+    else
+      upper_name[k] = pc->name[k];
+  }
+
+  upper_name[k] = '\0';
+
+  buffer = malloc(OUTPUT_MAX_HEADER_LENGTH +
+                  (long) C_HEADER_MAX_LINE_LENGTH * pc->num_colors);
+
+  if (buffer == NULL)
+  {
+    printf("Write C header failed: Out of memory.\n");
+    return 1;
+  }
+
+  /* header info */
+  p = buffer;
+
+  p += sprintf(p, "/* %s (%d colors, packed rgb) */\n\n",
+               pc->title, pc->num_colors);
+
+  p += sprintf(p, "#ifndef PALETTE_%s_H\n", upper_name);
+  p += sprintf(p, "#define PALETTE_%s_H\n\n", upper_name);
+
+  p += sprintf(p, "#include <stdint.h>\n\n");
+
+  p += sprintf(p, "#define %s_NUM_COLORS %d\n\n", upper_name, pc->num_colors);
+
+  p += sprintf(p, "static const uint8_t %s_colors[%s_NUM_COLORS * 3] =\n{",
+               pc->name, upper_name);
+
+  /* palette colors (4 colors per line) */
+
+  for (color_index = 0; color_index < pc->num_colors; color_index++)
+  {
+    c = &pc->colors_array[color_index];
+
+    if (color_index % 4 == 0)
+    {
+      memcpy(p, "\n  ", 3);
+      p += 3;
+    }
+    else
+    {
+      p[0] = ' ';
+      p += 1;
+    }
+
+    memcpy(p, hex[c->r], 4);
+    p[4] = ',';
+    p[5] = ' ';
+    memcpy(p + 6, hex[c->g], 4);
+    p[10] = ',';
+    p[11] = ' ';
+    memcpy(p + 12, hex[c->b], 4);
+    p += 16;
+
+    if (color_index < pc->num_colors - 1)
+    {
+      p[0] = ',';
+      p += 1;
+    }
+  }
+
+  p += sprintf(p, "\n};\n\n#endif\n");
+
+  /* write out the file (if it changed) */
+  if (replace_output_file(filename, buffer, p - buffer))
+  {
+    printf("Write C header failed: Unable to write output file.\n");
+    free(buffer);
+    return 1;
+  }
+
+  free(buffer);
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_raw_file()
+*******************************************************************************/
+short int write_raw_file(palette_context* pc, char* filename, int alpha)
+{
+  unsigned char*  data;
+  unsigned char*  p;
+
+  int             bytes_per_color;
+  int             color_index;
+
+  long            num_bytes;
+
+  /* make sure filename is valid */
+  if (filename == NULL)
+  {
+    printf("Write raw file failed: No filename specified.\n");
+    return 1;
+  }
+
+  /* packed rgb (or rgba, with opaque alpha), with no header, */
+  /* so the file can be mapped & used as is                   */
+  bytes_per_color = alpha ? 4 : 3;
+  num_bytes = (long) bytes_per_color * pc->num_colors;
+
+  data = malloc(num_bytes > 0 ? num_bytes : 1);
+
+  if (data == NULL)
+  {
+    printf("Write raw file failed: Out of memory.\n");
+    return 1;
+  }
+
+  p = data;
+
+  for (color_index = 0; color_index < pc->num_colors; color_index++)
+  {
+    p[0] = pc->colors_array[color_index].r;
+    p[1] = pc->colors_array[color_index].g;
+    p[2] = pc->colors_array[color_index].b;
+
+    if (alpha)
+      p[3] = 255;
+
+    p += bytes_per_color;
+  }
+
+  /* write it out (if it changed) */
+  if (replace_output_file(filename, (char*) data, num_bytes))
+  {
+    printf("Write raw file failed: Unable to write output file.\n");
+    free(data);
+    return 1;
+  }
+
+  free(data);
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_shader_file()
+*******************************************************************************/
+short int write_shader_file(palette_context* pc, char* filename, int format)
+{
+  char  upper_name[PALETTE_NAME_LENGTH];
+  char  normalized[256][8];
+  char  text[16];
+
+  char* vector_type;
+
+  char* buffer;
+  char* p;
+
+  color* c;
+
+  int   color_index;
+  int   k;
+  int   n;
+
+  /* make sure filename & format are valid */
+  if (filename == NULL)
+  {
+    printf("Write shader file failed: No filename specified.\n");
+    return 1;
+  }
+
+  if ((format != OUTPUT_FORMAT_GLSL) && (format != OUTPUT_FORMAT_HLSL))
+  {
+    printf("Write shader file failed: Unknown shader language.\n");
+    return 1;
+  }
+
+  /* build table of normalized channel values ("d.dddddd") */
+  for (k = 0; k < 256; k++)
+  {
+    sprintf(text, "%.6f", k / 255.0);
+    memcpy(normalized[k], text, 8);
+  }
+
+  for (k = 0; (pc->name[k] != '\0') && (k < PALETTE_NAME_LENGTH - 1); k++)
+  {
+    if ((pc->name[k] >= 'a') && (pc->name[k] <= 'z'))
+      upper_name[k] = pc->name[k] - 'a' + 'A';
+    else
+      upper_name[k] = pc->name[k];
+  }
+
+  upper_name[k] = '\0';
+
+  vector_type = (format == OUTPUT_FORMAT_GLSL) ? "vec3" : "float3";
+  n = strlen(vector_type);
+
+  buffer = malloc(OUTPUT_MAX_HEADER_LENGTH +
+                  (long) SHADER_MAX_LINE_LENGTH * pc->num_colors);
+
+  if (buffer == NULL)
+  {
+    printf("Write shader file failed: Out of memory.\n");
+    return 1;
+  }
+
+  /* header info */
+  p = buffer;
+
+  p += sprintf(p, "// %s (%d colors, normalized rgb)\n\n",
+               pc->title, pc->num_colors);
+
+  if (format == OUTPUT_FORMAT_GLSL)
+  {
+    p += sprintf(p, "const int %s_NUM_COLORS = %d;\n\n",
+                 upper_name, pc->num_colors);
+    p += sprintf(p, "const vec3 %s_colors[%s_NUM_COLORS] = vec3[](",
+                 pc->name, upper_name);
+  }
+  else
+  {
+    p += sprintf(p, "static const int %s_NUM_COLORS = %d;\n\n",
+                 upper_name, pc->num_colors);
+    p += sprintf(p, "static const float3 %s_colors[%d] =\n{",
+                 pc->name, pc->num_colors);
+  }
+
+  /* palette colors (one per line) */
+
+  for (color_index = 0; color_index < pc->num_colors; color_index++)
+  {
+    c = &pc->colors_array[color_index];
+
+    memcpy(p, "\n  ", 3);
+    p += 3;
+    memcpy(p, vector_type, n);
+    p += n;
+
+    p[0] = '(';
+    memcpy(p + 1, normalized[c->r], 8);
+    p[9] = ',';
+    p[10] = ' ';
+    memcpy(p + 11, normalized[c->g], 8);
+    p[19] = ',';
+    p[20] = ' ';
+    memcpy(p + 21, normalized[c->b], 8);
+    p[29] = ')';
+    p += 30;
+
+    if (color_index < pc->num_colors - 1)
+    {
+      p[0] = ',';
+      p += 1;
+    }
+  }
+
+  if (format == OUTPUT_FORMAT_GLSL)
+    p += sprintf(p, "\n);\n");
+  else
+    p += sprintf(p, "\n};\n");
+
+  /* write out the file (if it changed) */
+  if (replace_output_file(filename, buffer, p - buffer))
+  {
+    printf("Write shader file failed: Unable to write output file.\n");
+    free(buffer);
+    return 1;
+  }
+
+  free(buffer);
+
+  return 0;
+}
+
+/*******************************************************************************
+** write_output_file()
+*******************************************************************************/
+short int write_output_file(palette_context* pc, char* filename, int format)
+{
+  if (format == OUTPUT_FORMAT_C_HEADER)
+    return write_c_header_file(pc, filename);
+  else if (format == OUTPUT_FORMAT_RGB)
+    return write_raw_file(pc, filename, 0);
+  else if (format == OUTPUT_FORMAT_RGBA)
+    return write_raw_file(pc, filename, 1);
+  else if (format == OUTPUT_FORMAT_PAL)
+    return write_raw_file(pc, filename, 0);
+  else if ((format == OUTPUT_FORMAT_GLSL) || (format == OUTPUT_FORMAT_HLSL))
+    return write_shader_file(pc, filename, format);
+
+  printf("Write output file failed: Unknown format.\n");
+  return 1;
+}
@@ -0,0 +1,40 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** output.h (palette file output)
+*******************************************************************************/
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "palette.h"
+
+/* formats for embedding the palette in other programs */
+enum
+{
+  OUTPUT_FORMAT_C_HEADER = 0,
+  OUTPUT_FORMAT_RGB,
+  OUTPUT_FORMAT_RGBA,
+  OUTPUT_FORMAT_GLSL,
+  OUTPUT_FORMAT_HLSL,
+  OUTPUT_FORMAT_PAL,
+  OUTPUT_NUM_FORMATS
+};
+
+/* function declarations */
+short int replace_output_file(char* filename, char* data, long num_bytes);
+
+short int write_gpl_file(palette_context* pc, char* filename);
+short int write_tga_file(palette_context* pc, char* filename);
+
+int       output_format_from_name(char* name);
+char*     output_format_extension(int format);
+
+short int write_c_header_file(palette_context* pc, char* filename);
+short int write_raw_file(palette_context* pc, char* filename, int alpha);
+short int write_shader_file(palette_context* pc, char* filename, int format);
+short int write_output_file(palette_context* pc, char* filename, int format);
+
+#endif
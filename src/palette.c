@@ -0,0 +1,943 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** palette.c (palette context & generation)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "builtin.h"
+#include "fixed.h"
+#include "nes.h"
+#include "palette.h"
+#include "parallel.h"
+#include "signal.h"
+#include "yiq.h"
+
+#if 0
+/* the standard table step is 1 / (n + 2),  */
+/* where n is the number of colors per hue  */
+#define COMPOSITE_08_TABLE_STEP 0.1f                /* 1/10 */
+#define COMPOSITE_16_TABLE_STEP 0.055555555555556f  /* 1/18 */
+#define COMPOSITE_32_TABLE_STEP 0.029411764705882f  /* 1/34 */
+#endif
+
+/* the size of the table step is 1 / (n + 2), */
+/* where n is the number of colors per hue    */
+#define PALETTE_256_COLOR_TABLE_STEP  0.055555555555556f  /* 1/18 (n = 16) */
+#define PALETTE_1024_COLOR_TABLE_STEP 0.029411764705882f  /* 1/34 (n = 32) */
+
+/* palettes at least this large are generated on the worker pool, */
+/* with each job converting at least this many colors             */
+#define PALETTE_PARALLEL_MIN_COLORS 65536
+#define PALETTE_PARALLEL_JOB_COLORS 16384
+
+/* fixed-point rgb coefficients for the greys (no saturation) */
+static int S_fixed_grey_coefs[3] = {0, 0, 0};
+
+typedef struct composite_jobs
+{
+  palette_context*  pc;
+  int*              num_clamped;
+} composite_jobs;
+
+/* the luma is the average of the low and high voltages */
+/* for the 1st half of each table, the low value is 0   */
+/* for the 2nd half of each table, the high value is 1  */
+/* the saturation is half of the peak-to-peak voltage   */
+
+/* for the nes tables, the numbers were obtained    */
+/* from information on the nesdev wiki              */
+/* (see the "NTSC video" and "PPU palettes" pages); */
+/* the peak-to-peak voltages are                    */
+/* {0.399, 0.684, 0.692, 0.285}                     */
+static const float S_nes_lum[4] = {0.1995f,  0.342f, 0.654f, 0.8575f};
+static const float S_nes_sat[4] = {0.1995f,  0.342f, 0.346f, 0.1425f};
+
+/* note that if we used the "composite 04" table, */
+/* with the table step being 1/(4+2) = 1/6, we    */
+/* would obtain an approximation of these values! */
+/* (peak-to-peak {0.4, 0.7, 0.7, 0.3})            */
+static const float S_approx_nes_lum[4] = {0.2f, 0.35f, 0.65f,  0.85f};
+static const float S_approx_nes_sat[4] = {0.2f, 0.35f, 0.35f,  0.15f};
+
+/* source names (used for the command line & output filenames) */
+static char* S_source_names[SOURCE_NUM_SOURCES] =
+  { "approx_nes",
+    "approx_nes_rotated",
+    "composite_08",
+    "composite_16",
+    "composite_16_rotated",
+    "composite_32",
+    "nes",
+    "composite",
+    "signal"
+  };
+
+/* source titles (used for the gpl file header) */
+static char* S_source_titles[SOURCE_NUM_SOURCES] =
+  { "Approximate NES",
+    "Approximate NES Rotated",
+    "Composite 08",
+    "Composite 16",
+    "Composite 16 Rotated",
+    "Composite 32",
+    "NES",
+    "Composite",
+    "Signal"
+  };
+
+/*******************************************************************************
+** palette_source_from_name()
+*******************************************************************************/
+int palette_source_from_name(char* name)
+{
+  int k;
+
+  if (name == NULL)
+    return -1;
+
+  for (k = 0; k < SOURCE_NUM_SOURCES; k++)
+  {
+    if (!strcmp(S_source_names[k], name))
+      return k;
+  }
+
+  return -1;
+}
+
+/*******************************************************************************
+** palette_source_name()
+*******************************************************************************/
+char* palette_source_name(int source)
+{
+  if ((source < 0) || (source >= SOURCE_NUM_SOURCES))
+    return NULL;
+
+  return S_source_names[source];
+}
+
+/*******************************************************************************
+** palette_source_title()
+*******************************************************************************/
+char* palette_source_title(int source)
+{
+  if ((source < 0) || (source >= SOURCE_NUM_SOURCES))
+    return NULL;
+
+  return S_source_titles[source];
+}
+
+/*******************************************************************************
+** palette_source_is_custom()
+*******************************************************************************/
+int palette_source_is_custom(int source)
+{
+  if ((source == SOURCE_COMPOSITE_CUSTOM) || (source == SOURCE_SIGNAL))
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** palette_allocate()
+*******************************************************************************/
+static short int palette_allocate(palette_context* pc)
+{
+  /* allocate palette array, voltage tables & phasor tables */
+  pc->colors_array = malloc(sizeof(color) * pc->max_colors);
+  pc->luma_table = malloc(sizeof(float) * pc->table_length);
+  pc->saturation_table = malloc(sizeof(float) * pc->table_length);
+
+  pc->cos_table = malloc(sizeof(double) * pc->num_hues);
+  pc->sin_table = malloc(sizeof(double) * pc->num_hues);
+
+  if ((pc->colors_array == NULL)      ||
+      (pc->luma_table == NULL)        ||
+      (pc->saturation_table == NULL)  ||
+      (pc->cos_table == NULL)         ||
+      (pc->sin_table == NULL))
+  {
+    printf("Error allocating palette array.\n");
+    palette_deinit(pc);
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** palette_init()
+*******************************************************************************/
+short int palette_init(palette_context* pc, int source)
+{
+  if (pc == NULL)
+    return 1;
+
+  /* the custom sources default to the composite 16 layout */
+  if (source == SOURCE_COMPOSITE_CUSTOM)
+    return palette_init_custom(pc, 16, 12);
+
+  if (source == SOURCE_SIGNAL)
+    return palette_init_signal(pc, 16, 12);
+
+  /* initialization */
+  pc->source = source;
+
+  pc->name[0] = '\0';
+  pc->title[0] = '\0';
+
+  pc->colors_array = NULL;
+  pc->num_colors = 0;
+  pc->max_colors = 0;
+  pc->num_clamped = 0;
+
+  pc->luma_table = NULL;
+  pc->saturation_table = NULL;
+  pc->table_length = 0;
+
+  pc->num_hues = 12;
+  pc->phi = 0.0f;
+
+  pc->cos_table = NULL;
+  pc->sin_table = NULL;
+
+  pc->fixed_point = 0;
+  pc->luma_fixed = NULL;
+  pc->saturation_fixed = NULL;
+  pc->phasor_fixed = NULL;
+
+  pc->signal_rate = SIGNAL_DEFAULT_RATE;
+  pc->signal_filter = SIGNAL_FILTER_BOX;
+  pc->signal_taps = 0;
+
+  /* determine table length, number of hues & max palette colors */
+  if ((source == SOURCE_APPROX_NES) ||
+      (source == SOURCE_APPROX_NES_ROTATED))
+  {
+    pc->table_length = 4;
+    pc->max_colors = 64;
+  }
+  else if (source == SOURCE_COMPOSITE_08)
+  {
+    pc->table_length = 8;
+    pc->num_hues = 24;
+    pc->max_colors = 256;
+  }
+  else if (source == SOURCE_COMPOSITE_16)
+  {
+    pc->table_length = 16;
+    pc->max_colors = 256;
+  }
+  else if (source == SOURCE_COMPOSITE_16_ROTATED)
+  {
+    pc->table_length = 16;
+    pc->phi = PI / 12.0f; /* 15 degrees */
+    pc->max_colors = 256;
+  }
+  else if (source == SOURCE_COMPOSITE_32)
+  {
+    pc->table_length = 32;
+    pc->num_hues = 24;
+    pc->max_colors = 1024;
+  }
+  else if (source == SOURCE_NES)
+  {
+    pc->table_length = 4;
+    pc->max_colors = NES_NUM_COLORS * NES_NUM_EMPHASIS;
+  }
+  else
+  {
+    printf("Unable to initialize palette; invalid source specified.\n");
+    return 1;
+  }
+
+  strcpy(pc->name, S_source_names[source]);
+  strcpy(pc->title, S_source_titles[source]);
+
+  return palette_allocate(pc);
+}
+
+/*******************************************************************************
+** palette_init_custom()
+*******************************************************************************/
+short int palette_init_custom(palette_context* pc,
+                              int table_length, int num_hues)
+{
+  if (pc == NULL)
+    return 1;
+
+  /* initialization */
+  pc->source = SOURCE_COMPOSITE_CUSTOM;
+
+  pc->name[0] = '\0';
+  pc->title[0] = '\0';
+
+  pc->colors_array = NULL;
+  pc->num_colors = 0;
+  pc->max_colors = 0;
+  pc->num_clamped = 0;
+
+  pc->luma_table = NULL;
+  pc->saturation_table = NULL;
+  pc->table_length = 0;
+
+  pc->num_hues = 0;
+  pc->phi = 0.0f;
+
+  pc->cos_table = NULL;
+  pc->sin_table = NULL;
+
+  pc->fixed_point = 0;
+  pc->luma_fixed = NULL;
+  pc->saturation_fixed = NULL;
+  pc->phasor_fixed = NULL;
+
+  pc->signal_rate = SIGNAL_DEFAULT_RATE;
+  pc->signal_filter = SIGNAL_FILTER_BOX;
+  pc->signal_taps = 0;
+
+  /* the tables are split into a low & high half, */
+  /* so the number of luma steps must be even     */
+  if ((table_length < 2)                        ||
+      (table_length > PALETTE_MAX_TABLE_LENGTH) ||
+      (table_length % 2 != 0))
+  {
+    printf("Unable to initialize palette; ");
+    printf("number of luma steps must be an even number from 2 to %d.\n",
+           PALETTE_MAX_TABLE_LENGTH);
+    return 1;
+  }
+
+  if ((num_hues < 1) || (num_hues > PALETTE_MAX_NUM_HUES))
+  {
+    printf("Unable to initialize palette; ");
+    printf("number of hues must be from 1 to %d.\n", PALETTE_MAX_NUM_HUES);
+    return 1;
+  }
+
+  /* there is one column of greys, and one column per hue */
+  if (table_length > PALETTE_MAX_NUM_COLORS / (num_hues + 1))
+  {
+    printf("Unable to initialize palette; ");
+    printf("number of colors must be at most %d.\n", PALETTE_MAX_NUM_COLORS);
+    return 1;
+  }
+
+  pc->table_length = table_length;
+  pc->num_hues = num_hues;
+  pc->max_colors = table_length * (num_hues + 1);
+
+  sprintf(pc->name, "composite_%dx%d", table_length, num_hues);
+  sprintf(pc->title, "Composite %dx%d", table_length, num_hues);
+
+  return palette_allocate(pc);
+}
+
+/*******************************************************************************
+** palette_init_signal()
+*******************************************************************************/
+short int palette_init_signal(palette_context* pc,
+                              int table_length, int num_hues)
+{
+  /* the same layout & voltage tables as the custom composite */
+  /* palettes, but decoded from a sampled waveform            */
+  if (palette_init_custom(pc, table_length, num_hues))
+    return 1;
+
+  pc->source = SOURCE_SIGNAL;
+
+  sprintf(pc->name, "signal_%dx%d", table_length, num_hues);
+  sprintf(pc->title, "Signal %dx%d", table_length, num_hues);
+
+  return 0;
+}
+
+/*******************************************************************************
+** palette_deinit()
+*******************************************************************************/
+void palette_deinit(palette_context* pc)
+{
+  if (pc == NULL)
+    return;
+
+  if (pc->colors_array != NULL)
+  {
+    free(pc->colors_array);
+    pc->colors_array = NULL;
+  }
+
+  if (pc->luma_table != NULL)
+  {
+    free(pc->luma_table);
+    pc->luma_table = NULL;
+  }
+
+  if (pc->saturation_table != NULL)
+  {
+    free(pc->saturation_table);
+    pc->saturation_table = NULL;
+  }
+
+  if (pc->cos_table != NULL)
+  {
+    free(pc->cos_table);
+    pc->cos_table = NULL;
+  }
+
+  if (pc->sin_table != NULL)
+  {
+    free(pc->sin_table);
+    pc->sin_table = NULL;
+  }
+
+  if (pc->luma_fixed != NULL)
+  {
+    free(pc->luma_fixed);
+    pc->luma_fixed = NULL;
+  }
+
+  if (pc->saturation_fixed != NULL)
+  {
+    free(pc->saturation_fixed);
+    pc->saturation_fixed = NULL;
+  }
+
+  if (pc->phasor_fixed != NULL)
+  {
+    free(pc->phasor_fixed);
+    pc->phasor_fixed = NULL;
+  }
+
+  pc->num_colors = 0;
+  pc->max_colors = 0;
+  pc->num_clamped = 0;
+  pc->table_length = 0;
+}
+
+/*******************************************************************************
+** palette_fixed_point()
+*******************************************************************************/
+static int palette_fixed_point(palette_context* pc)
+{
+  /* the sampled signal sources are always decoded in floating point */
+  return pc->fixed_point                &&
+         (pc->source != SOURCE_NES)     &&
+         (pc->source != SOURCE_SIGNAL);
+}
+
+/*******************************************************************************
+** palette_builtin_get()
+*******************************************************************************/
+static const palette_builtin* palette_builtin_get(palette_context* pc)
+{
+#ifndef PALETTE_NO_BUILTIN
+  const palette_builtin* pb;
+
+  /* the built-in sources were generated at build time  */
+  /* (with the float path, so the fixed-point path and   */
+  /* the custom source are always generated at run time) */
+  if (palette_fixed_point(pc) || palette_source_is_custom(pc->source))
+    return NULL;
+
+  if ((pc->source < 0) || (pc->source >= SOURCE_NUM_SOURCES))
+    return NULL;
+
+  pb = &palette_builtins[pc->source];
+
+  if ((pb->colors == NULL)                    ||
+      (pb->table_length != pc->table_length)  ||
+      (pb->num_hues != pc->num_hues))
+  {
+    return NULL;
+  }
+
+  return pb;
+#else
+  (void) pc;
+
+  return NULL;
+#endif
+}
+
+/*******************************************************************************
+** palette_builtin_colors()
+*******************************************************************************/
+const color* palette_builtin_colors(int source, int* num_colors)
+{
+  /* the built-in palettes can be used in place, with no context at all */
+  *num_colors = 0;
+
+#ifndef PALETTE_NO_BUILTIN
+  if ((source < 0) || (source >= SOURCE_NUM_SOURCES))
+    return NULL;
+
+  if (palette_builtins[source].colors == NULL)
+    return NULL;
+
+  *num_colors = palette_builtins[source].num_colors;
+
+  return palette_builtins[source].colors;
+#else
+  (void) source;
+
+  return NULL;
+#endif
+}
+
+/*******************************************************************************
+** generate_voltage_tables()
+*******************************************************************************/
+short int generate_voltage_tables(palette_context* pc)
+{
+  int k;
+
+  float* lum;
+  float* sat;
+
+  float step;
+
+  const palette_builtin* pb;
+
+  /* fixed-point tables */
+  if (palette_fixed_point(pc))
+    return fixed_voltage_tables(pc);
+
+  /* built-in tables */
+  pb = palette_builtin_get(pc);
+
+  if (pb != NULL)
+  {
+    memcpy(pc->luma_table, pb->luma_table, sizeof(float) * pc->table_length);
+    memcpy( pc->saturation_table, pb->saturation_table,
+            sizeof(float) * pc->table_length);
+    return 0;
+  }
+
+  lum = pc->luma_table;
+  sat = pc->saturation_table;
+
+  /* approx nes tables */
+  if ((pc->source == SOURCE_APPROX_NES) ||
+      (pc->source == SOURCE_APPROX_NES_ROTATED))
+  {
+    for (k = 0; k < 4; k++)
+    {
+      lum[k] = S_approx_nes_lum[k];
+      sat[k] = S_approx_nes_sat[k];
+    }
+  }
+  /* nes tables */
+  else if (pc->source == SOURCE_NES)
+  {
+    for (k = 0; k < 4; k++)
+    {
+      lum[k] = S_nes_lum[k];
+      sat[k] = S_nes_sat[k];
+    }
+  }
+  /* composite 08 tables */
+  else if (pc->source == SOURCE_COMPOSITE_08)
+  {
+    for (k = 0; k < 4; k++)
+    {
+      /* the table should include steps 1, 3, 6, and 8 */
+      if (k < 2)
+        lum[k] = (2 * k + 1) * PALETTE_256_COLOR_TABLE_STEP;
+      else
+        lum[k] = (2 * k + 2) * PALETTE_256_COLOR_TABLE_STEP;
+
+      lum[7 - k] = 1.0f - lum[k];
+
+      sat[k] = lum[k];
+      sat[7 - k] = sat[k];
+    }
+  }
+  /* composite 16 tables */
+  else if ( (pc->source == SOURCE_COMPOSITE_16) ||
+            (pc->source == SOURCE_COMPOSITE_16_ROTATED))
+  {
+    for (k = 0; k < 8; k++)
+    {
+      lum[k] = (k + 1) * PALETTE_256_COLOR_TABLE_STEP;
+      lum[15 - k] = 1.0f - lum[k];
+
+      sat[k] = lum[k];
+      sat[15 - k] = sat[k];
+    }
+  }
+  /* composite 32 tables */
+  else if (pc->source == SOURCE_COMPOSITE_32)
+  {
+    for (k = 0; k < 16; k++)
+    {
+      lum[k] = (k + 1) * PALETTE_1024_COLOR_TABLE_STEP;
+      lum[31 - k] = 1.0f - lum[k];
+
+      sat[k] = lum[k];
+      sat[31 - k] = sat[k];
+    }
+  }
+  /* custom composite & signal tables */
+  else if ( (pc->source == SOURCE_COMPOSITE_CUSTOM) ||
+            (pc->source == SOURCE_SIGNAL))
+  {
+    step = 1.0f / (pc->table_length + 2);
+
+    for (k = 0; k < pc->table_length / 2; k++)
+    {
+      lum[k] = (k + 1) * step;
+      lum[pc->table_length - 1 - k] = 1.0f - lum[k];
+
+      sat[k] = lum[k];
+      sat[pc->table_length - 1 - k] = sat[k];
+    }
+  }
+  else
+  {
+    printf("Cannot generate voltage tables; invalid source specified.\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** generate_phasor_tables()
+*******************************************************************************/
+short int generate_phasor_tables(palette_context* pc)
+{
+  int m;
+
+  int hue;
+  int step;
+
+  const palette_builtin* pb;
+
+  /* the phasors depend only on the hue, so they are computed */
+  /* once per palette and shared by all of the luma steps     */
+
+  /* fixed-point phasors */
+  if (palette_fixed_point(pc))
+    return fixed_phasor_tables(pc);
+
+  /* built-in phasors */
+  pb = palette_builtin_get(pc);
+
+  if (pb != NULL)
+  {
+    memcpy(pc->cos_table, pb->cos_table, sizeof(double) * pc->num_hues);
+    memcpy(pc->sin_table, pb->sin_table, sizeof(double) * pc->num_hues);
+    return 0;
+  }
+
+  /* approx nes phasors (in whole degrees) */
+  if ((pc->source == SOURCE_APPROX_NES) ||
+      (pc->source == SOURCE_APPROX_NES_ROTATED))
+  {
+    /* set hue step & hue start */
+    if (pc->source == SOURCE_APPROX_NES_ROTATED)
+    {
+      step = 30;
+      hue = 15;
+    }
+    else
+    {
+      step = 30;
+      hue = 0;
+    }
+
+    for (m = 0; m < pc->num_hues; m++)
+    {
+      pc->cos_table[m] = cos(TWO_PI * hue / 360.0f);
+      pc->sin_table[m] = sin(TWO_PI * hue / 360.0f);
+
+      /* increment hue */
+      hue += step;
+      hue = hue % 360;
+    }
+  }
+  /* composite phasors */
+  else
+  {
+    for (m = 0; m < pc->num_hues; m++)
+    {
+      pc->cos_table[m] = cos(((TWO_PI * m) / pc->num_hues) + pc->phi);
+      pc->sin_table[m] = sin(((TWO_PI * m) / pc->num_hues) + pc->phi);
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** add_color()
+*******************************************************************************/
+short int add_color(palette_context* pc,
+                    unsigned char r, unsigned char g, unsigned char b)
+{
+  /* make sure array index is valid */
+  if ((pc->num_colors < 0) || (pc->num_colors >= pc->max_colors))
+  {
+    printf("Unable to add color: Colors array is filled.\n");
+    return 1;
+  }
+
+  /* add color */
+  pc->colors_array[pc->num_colors].r = r;
+  pc->colors_array[pc->num_colors].g = g;
+  pc->colors_array[pc->num_colors].b = b;
+
+  pc->num_colors += 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** convert_column()
+*******************************************************************************/
+static int convert_column(palette_context* pc, int column, color* output)
+{
+  int m;
+
+  /* column 0 is the greys, and column m + 1 is hue m */
+  m = column - 1;
+
+  if (pc->fixed_point)
+  {
+    return fixed_convert_column(pc->luma_fixed, pc->saturation_fixed,
+                                pc->table_length,
+                                (column == 0) ? S_fixed_grey_coefs
+                                              : &pc->phasor_fixed[3 * m],
+                                output);
+  }
+
+  if (column == 0)
+  {
+    return yiq_convert_column(pc->luma_table, pc->saturation_table,
+                              pc->table_length, 0.0, 0.0, output);
+  }
+
+  return yiq_convert_column(pc->luma_table, pc->saturation_table,
+                            pc->table_length,
+                            pc->cos_table[m], pc->sin_table[m], output);
+}
+
+/*******************************************************************************
+** add_column()
+*******************************************************************************/
+static short int add_column(palette_context* pc, int column)
+{
+  /* make sure there is room for the whole column */
+  if (pc->num_colors + pc->table_length > pc->max_colors)
+  {
+    printf("Unable to add colors: Colors array is filled.\n");
+    return 1;
+  }
+
+  /* convert one color per luma step */
+  pc->num_clamped +=
+    convert_column(pc, column, &pc->colors_array[pc->num_colors]);
+
+  pc->num_colors += pc->table_length;
+
+  return 0;
+}
+
+/*******************************************************************************
+** generate_palette_approx_nes()
+*******************************************************************************/
+short int generate_palette_approx_nes(palette_context* pc)
+{
+  int m;
+
+  /* add pure black */
+  add_color(pc, 0, 0, 0);
+
+  /* add greys (a column with no saturation) */
+  add_column(pc, 0);
+
+  /* add pure white */
+  add_color(pc, 255, 255, 255);
+
+  /* add hues */
+  for (m = 0; m < pc->num_hues; m++)
+    add_column(pc, m + 1);
+
+  return 0;
+}
+
+/*******************************************************************************
+** generate_composite_columns()
+*******************************************************************************/
+static void generate_composite_columns(void* data, int index)
+{
+  composite_jobs*   jobs;
+  palette_context*  pc;
+
+  int   columns_per_job;
+  int   column;
+  int   end;
+
+  jobs = (composite_jobs*) data;
+  pc = jobs->pc;
+
+  columns_per_job = PALETTE_PARALLEL_JOB_COLORS / pc->table_length + 1;
+
+  column = index * columns_per_job;
+  end = column + columns_per_job;
+
+  if (end > pc->num_hues + 1)
+    end = pc->num_hues + 1;
+
+  /* each job keeps its own clamp count, so */
+  /* the jobs never write to the same place */
+  jobs->num_clamped[index] = 0;
+
+  for (; column < end; column++)
+  {
+    jobs->num_clamped[index] +=
+      convert_column( pc, column,
+                      &pc->colors_array[pc->num_colors +
+                                        column * pc->table_length]);
+  }
+}
+
+/*******************************************************************************
+** generate_palette_composite()
+*******************************************************************************/
+short int generate_palette_composite(palette_context* pc)
+{
+  composite_jobs jobs;
+
+  int num_colors;
+  int columns_per_job;
+  int num_jobs;
+  int k;
+
+  /* there is one column of greys, and one column per hue */
+  num_colors = pc->table_length * (pc->num_hues + 1);
+
+  if (pc->num_colors + num_colors > pc->max_colors)
+  {
+    printf("Unable to add colors: Colors array is filled.\n");
+    return 1;
+  }
+
+  columns_per_job = PALETTE_PARALLEL_JOB_COLORS / pc->table_length + 1;
+  num_jobs = (pc->num_hues + 1 + columns_per_job - 1) / columns_per_job;
+
+  jobs.pc = pc;
+  jobs.num_clamped = malloc(sizeof(int) * num_jobs);
+
+  if (jobs.num_clamped == NULL)
+  {
+    printf("Unable to add colors: Out of memory.\n");
+    return 1;
+  }
+
+  /* generate greys & hues (large palettes are split across threads) */
+  if (num_colors >= PALETTE_PARALLEL_MIN_COLORS)
+  {
+    if (parallel_run(num_jobs, generate_composite_columns, &jobs))
+    {
+      free(jobs.num_clamped);
+      return 1;
+    }
+  }
+  else
+  {
+    for (k = 0; k < num_jobs; k++)
+      generate_composite_columns(&jobs, k);
+  }
+
+  for (k = 0; k < num_jobs; k++)
+    pc->num_clamped += jobs.num_clamped[k];
+
+  free(jobs.num_clamped);
+
+  pc->num_colors += num_colors;
+
+  return 0;
+}
+
+/*******************************************************************************
+** generate_palette_colors()
+*******************************************************************************/
+short int generate_palette_colors(palette_context* pc)
+{
+  const palette_builtin* pb;
+
+  /* reset palette */
+  pc->num_colors = 0;
+  pc->num_clamped = 0;
+
+  /* built-in palette */
+  pb = palette_builtin_get(pc);
+
+  if (pb != NULL)
+  {
+    if (pb->num_colors > pc->max_colors)
+    {
+      printf("Unable to add colors: Colors array is filled.\n");
+      return 1;
+    }
+
+    memcpy(pc->colors_array, pb->colors, sizeof(color) * pb->num_colors);
+
+    pc->num_colors = pb->num_colors;
+    pc->num_clamped = pb->num_clamped;
+
+    return 0;
+  }
+
+  /* generate palette */
+  if ((pc->source == SOURCE_APPROX_NES) ||
+      (pc->source == SOURCE_APPROX_NES_ROTATED))
+  {
+    return generate_palette_approx_nes(pc);
+  }
+  else if ( (pc->source == SOURCE_COMPOSITE_08)          ||
+            (pc->source == SOURCE_COMPOSITE_16)          ||
+            (pc->source == SOURCE_COMPOSITE_16_ROTATED)  ||
+            (pc->source == SOURCE_COMPOSITE_32)          ||
+            (pc->source == SOURCE_COMPOSITE_CUSTOM))
+  {
+    return generate_palette_composite(pc);
+  }
+  else if (pc->source == SOURCE_NES)
+    return generate_palette_nes(pc);
+  else if (pc->source == SOURCE_SIGNAL)
+    return generate_palette_signal(pc);
+
+  printf("Cannot generate palette; invalid source specified.\n");
+  return 1;
+}
+
+/*******************************************************************************
+** palette_generate()
+*******************************************************************************/
+short int palette_generate(palette_context* pc)
+{
+  if (pc == NULL)
+    return 1;
+
+  /* generate voltage tables */
+  if (generate_voltage_tables(pc))
+    return 1;
+
+  /* generate phasor tables */
+  if (generate_phasor_tables(pc))
+    return 1;
+
+  /* generate palette */
+  if (generate_palette_colors(pc))
+    return 1;
+
+  return 0;
+}
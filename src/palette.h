@@ -0,0 +1,115 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** palette.h (palette context & generation)
+*******************************************************************************/
+
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#define PI      3.14159265358979323846f
+#define TWO_PI  6.28318530717958647693f
+
+typedef struct color
+{
+  unsigned char r;
+  unsigned char g;
+  unsigned char b;
+} color;
+
+enum
+{
+  /* 64 color palettes */
+  SOURCE_APPROX_NES = 0,
+  SOURCE_APPROX_NES_ROTATED,
+  /* 256 color palettes */
+  SOURCE_COMPOSITE_08,
+  SOURCE_COMPOSITE_16,
+  SOURCE_COMPOSITE_16_ROTATED,
+  /* 1024 color palettes */
+  SOURCE_COMPOSITE_32,
+  /* 512 color palettes (64 colors x 8 emphasis settings) */
+  SOURCE_NES,
+  /* any size palettes (luma steps x hues) */
+  SOURCE_COMPOSITE_CUSTOM,
+  SOURCE_SIGNAL,
+  SOURCE_NUM_SOURCES
+};
+
+/* limits for the custom composite palettes */
+#define PALETTE_MAX_TABLE_LENGTH  65536
+#define PALETTE_MAX_NUM_HUES      65536
+#define PALETTE_MAX_NUM_COLORS    (1 << 26)
+
+#define PALETTE_NAME_LENGTH 64
+
+/* all of the state needed to generate a palette;   */
+/* each context is independent, so several palettes */
+/* can be generated at once (one per thread)        */
+typedef struct palette_context
+{
+  int     source;
+
+  char    name[PALETTE_NAME_LENGTH];
+  char    title[PALETTE_NAME_LENGTH];
+
+  color*  colors_array;
+  int     num_colors;
+  int     max_colors;
+
+  /* colors that fell outside of the rgb cube */
+  int     num_clamped;
+
+  float*  luma_table;
+  float*  saturation_table;
+  int     table_length;
+
+  int     num_hues;
+  float   phi;
+
+  double* cos_table;
+  double* sin_table;
+
+  /* integer decode path (see fixed.c); the tables are */
+  /* only allocated once the path has been used         */
+  int     fixed_point;
+  int*    luma_fixed;
+  int*    saturation_fixed;
+  int*    phasor_fixed;
+
+  /* sampled composite signal source (see signal.c) */
+  int     signal_rate;
+  int     signal_filter;
+  int     signal_taps;
+} palette_context;
+
+/* function declarations */
+short int palette_init(palette_context* pc, int source);
+short int palette_init_custom(palette_context* pc,
+                              int table_length, int num_hues);
+short int palette_init_signal(palette_context* pc,
+                              int table_length, int num_hues);
+void      palette_deinit(palette_context* pc);
+
+int       palette_source_from_name(char* name);
+char*     palette_source_name(int source);
+char*     palette_source_title(int source);
+int       palette_source_is_custom(int source);
+
+const color*  palette_builtin_colors(int source, int* num_colors);
+
+short int generate_voltage_tables(palette_context* pc);
+short int generate_phasor_tables(palette_context* pc);
+
+short int add_color(palette_context* pc,
+                    unsigned char r, unsigned char g, unsigned char b);
+
+short int generate_palette_approx_nes(palette_context* pc);
+short int generate_palette_composite(palette_context* pc);
+short int generate_palette_colors(palette_context* pc);
+
+short int palette_generate(palette_context* pc);
+
+#endif
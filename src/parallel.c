@@ -0,0 +1,185 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** parallel.c (worker pool)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+#define PARALLEL_MAX_THREADS 64
+
+typedef struct parallel_pool
+{
+  pthread_mutex_t lock;
+
+  parallel_job    job;
+  void*           data;
+
+  int             next_job;
+  int             num_jobs;
+} parallel_pool;
+
+/* 0 means use the number of online processors */
+static int S_num_threads = 0;
+
+/* each thread that is taking jobs from a pool points this key  */
+/* at the pool, so that a job which itself calls parallel_run() */
+/* runs its own jobs inline (rather than starting more threads) */
+static pthread_once_t S_worker_once = PTHREAD_ONCE_INIT;
+static pthread_key_t  S_worker_key;
+static int            S_worker_key_created = 0;
+
+/*******************************************************************************
+** parallel_num_threads()
+*******************************************************************************/
+int parallel_num_threads(void)
+{
+  long num_cpus;
+
+  if (S_num_threads > 0)
+    return S_num_threads;
+
+  num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (num_cpus < 1)
+    return 1;
+  else if (num_cpus > PARALLEL_MAX_THREADS)
+    return PARALLEL_MAX_THREADS;
+
+  return (int) num_cpus;
+}
+
+/*******************************************************************************
+** parallel_set_num_threads()
+*******************************************************************************/
+void parallel_set_num_threads(int num_threads)
+{
+  if (num_threads < 0)
+    num_threads = 0;
+  else if (num_threads > PARALLEL_MAX_THREADS)
+    num_threads = PARALLEL_MAX_THREADS;
+
+  S_num_threads = num_threads;
+}
+
+/*******************************************************************************
+** parallel_create_worker_key()
+*******************************************************************************/
+static void parallel_create_worker_key(void)
+{
+  if (pthread_key_create(&S_worker_key, NULL) == 0)
+    S_worker_key_created = 1;
+}
+
+/*******************************************************************************
+** parallel_worker()
+*******************************************************************************/
+static void* parallel_worker(void* arg)
+{
+  parallel_pool* pool;
+
+  int index;
+
+  pool = (parallel_pool*) arg;
+
+  if (S_worker_key_created)
+    pthread_setspecific(S_worker_key, pool);
+
+  /* keep taking the next job until there are none left */
+  while (1)
+  {
+    pthread_mutex_lock(&pool->lock);
+    index = pool->next_job;
+    pool->next_job += 1;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (index >= pool->num_jobs)
+      break;
+
+    pool->job(pool->data, index);
+  }
+
+  return NULL;
+}
+
+/*******************************************************************************
+** parallel_run()
+*******************************************************************************/
+short int parallel_run(int num_jobs, parallel_job job, void* data)
+{
+  parallel_pool pool;
+
+  pthread_t     threads[PARALLEL_MAX_THREADS];
+  int           num_threads;
+  int           num_started;
+
+  int           k;
+
+  if ((num_jobs <= 0) || (job == NULL))
+    return 0;
+
+  /* determine number of worker threads (jobs that are */
+  /* already running in a pool do not start any more)   */
+  num_threads = parallel_num_threads();
+
+  if (num_threads > num_jobs)
+    num_threads = num_jobs;
+
+  pthread_once(&S_worker_once, parallel_create_worker_key);
+
+  if (S_worker_key_created && (pthread_getspecific(S_worker_key) != NULL))
+    num_threads = 1;
+
+  /* if there is only one worker, just run the jobs here */
+  if (num_threads <= 1)
+  {
+    for (k = 0; k < num_jobs; k++)
+      job(data, k);
+
+    return 0;
+  }
+
+  /* initialize pool */
+  pool.job = job;
+  pool.data = data;
+  pool.next_job = 0;
+  pool.num_jobs = num_jobs;
+
+  if (pthread_mutex_init(&pool.lock, NULL))
+  {
+    printf("Unable to initialize worker pool.\n");
+    return 1;
+  }
+
+  /* start workers (the calling thread is worker 0) */
+  num_started = 0;
+
+  for (k = 1; k < num_threads; k++)
+  {
+    if (pthread_create(&threads[k], NULL, parallel_worker, &pool))
+      break;
+
+    num_started += 1;
+  }
+
+  parallel_worker(&pool);
+
+  /* the calling thread is no longer taking jobs */
+  if (S_worker_key_created)
+    pthread_setspecific(S_worker_key, NULL);
+
+  /* wait for workers */
+  for (k = 1; k <= num_started; k++)
+    pthread_join(threads[k], NULL);
+
+  pthread_mutex_destroy(&pool.lock);
+
+  return 0;
+}
@@ -0,0 +1,21 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** parallel.h (worker pool)
+*******************************************************************************/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/* a job is called once for each index in [0, num_jobs) */
+typedef void (*parallel_job)(void* data, int index);
+
+/* function declarations */
+int       parallel_num_threads(void);
+void      parallel_set_num_threads(int num_threads);
+
+short int parallel_run(int num_jobs, parallel_job job, void* data);
+
+#endif
@@ -0,0 +1,391 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** quantize.c (image quantization)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "image.h"
+#include "nearest.h"
+#include "palette.h"
+#include "parallel.h"
+#include "quantize.h"
+#include "timer.h"
+
+/* the image is processed in bands of rows, with */
+/* about this many pixels in each band           */
+#define QUANTIZE_BAND_PIXELS (1 << 20)
+
+/* error diffusion keeps the error for the current row and the next */
+/* two rows, with 2 pixels of padding on each side; errors are kept  */
+/* in 1/16 units, so the weights below are all whole numbers         */
+#define QUANTIZE_ERROR_ROWS     3
+#define QUANTIZE_ERROR_PADDING  2
+
+typedef struct quantize_band
+{
+  nearest_index*  ni;
+  color*          palette;
+
+  color*          pixels;
+  int*            indices;
+
+  int             width;
+  int             first_row;
+
+  int             dither;
+  int             spread;
+
+  int*            error_rows[QUANTIZE_ERROR_ROWS];
+} quantize_band;
+
+/* 8x8 bayer matrix (values 0 - 63) */
+static int S_bayer_matrix[8][8] =
+  { { 0, 32,  8, 40,  2, 34, 10, 42},
+    {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44,  4, 36, 14, 46,  6, 38},
+    {60, 28, 52, 20, 62, 30, 54, 22},
+    { 3, 35, 11, 43,  1, 33,  9, 41},
+    {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47,  7, 39, 13, 45,  5, 37},
+    {63, 31, 55, 23, 61, 29, 53, 21}
+  };
+
+/* dither names (used for the command line) */
+static char* S_dither_names[] =
+  { "none",
+    "fs",
+    "atkinson",
+    "bayer",
+    NULL
+  };
+
+/*******************************************************************************
+** quantize_dither_from_name()
+*******************************************************************************/
+int quantize_dither_from_name(char* name)
+{
+  int k;
+
+  if (name == NULL)
+    return -1;
+
+  for (k = 0; S_dither_names[k] != NULL; k++)
+  {
+    if (!strcmp(S_dither_names[k], name))
+      return k;
+  }
+
+  return -1;
+}
+
+/*******************************************************************************
+** quantize_clamp()
+*******************************************************************************/
+static int quantize_clamp(int value)
+{
+  if (value < 0)
+    return 0;
+  else if (value > 255)
+    return 255;
+
+  return value;
+}
+
+/*******************************************************************************
+** quantize_row()
+*******************************************************************************/
+static void quantize_row(void* data, int row)
+{
+  quantize_band*  band;
+
+  color*          pixels;
+  int*            indices;
+
+  int x;
+
+  band = (quantize_band*) data;
+
+  pixels = &band->pixels[row * band->width];
+  indices = &band->indices[row * band->width];
+
+  for (x = 0; x < band->width; x++)
+    indices[x] = nearest_index_query(band->ni, pixels[x].r,
+                                               pixels[x].g,
+                                               pixels[x].b);
+}
+
+/*******************************************************************************
+** quantize_row_ordered()
+*******************************************************************************/
+static void quantize_row_ordered(void* data, int row)
+{
+  quantize_band*  band;
+
+  color*          pixels;
+  int*            indices;
+
+  int offsets[8];
+  int y;
+  int x;
+
+  band = (quantize_band*) data;
+
+  pixels = &band->pixels[row * band->width];
+  indices = &band->indices[row * band->width];
+
+  /* the rows have no dependence on each other, so they */
+  /* only need to know where they are in the image      */
+  y = (band->first_row + row) & 7;
+
+  for (x = 0; x < 8; x++)
+  {
+    offsets[x] =  (((2 * S_bayer_matrix[y][x] + 1) * band->spread) / 128) -
+                  (band->spread / 2);
+  }
+
+  for (x = 0; x < band->width; x++)
+  {
+    indices[x] = nearest_index_query(
+                  band->ni, quantize_clamp(pixels[x].r + offsets[x & 7]),
+                            quantize_clamp(pixels[x].g + offsets[x & 7]),
+                            quantize_clamp(pixels[x].b + offsets[x & 7]));
+  }
+}
+
+/*******************************************************************************
+** quantize_rows_diffused()
+*******************************************************************************/
+static void quantize_rows_diffused(quantize_band* band, int num_rows)
+{
+  color*  pixels;
+  int*    indices;
+  color*  c;
+
+  int*    cur;
+  int*    next;
+  int*    next_2;
+  int*    e;
+
+  int     value[3];
+  int     error[3];
+
+  int     row;
+  int     x;
+  int     k;
+
+  for (row = 0; row < num_rows; row++)
+  {
+    pixels = &band->pixels[row * band->width];
+    indices = &band->indices[row * band->width];
+
+    cur = band->error_rows[0] + (3 * QUANTIZE_ERROR_PADDING);
+    next = band->error_rows[1] + (3 * QUANTIZE_ERROR_PADDING);
+    next_2 = band->error_rows[2] + (3 * QUANTIZE_ERROR_PADDING);
+
+    for (x = 0; x < band->width; x++)
+    {
+      e = &cur[3 * x];
+
+      /* add the error carried to this pixel (rounded from 1/16 units) */
+      value[0] = pixels[x].r;
+      value[1] = pixels[x].g;
+      value[2] = pixels[x].b;
+
+      for (k = 0; k < 3; k++)
+      {
+        if (e[k] >= 0)
+          value[k] = quantize_clamp(value[k] + ((e[k] + 8) / 16));
+        else
+          value[k] = quantize_clamp(value[k] - ((8 - e[k]) / 16));
+      }
+
+      indices[x] = nearest_index_query(band->ni, value[0], value[1], value[2]);
+
+      c = &band->palette[indices[x]];
+
+      error[0] = value[0] - c->r;
+      error[1] = value[1] - c->g;
+      error[2] = value[2] - c->b;
+
+      /* spread the error to the neighboring pixels */
+      for (k = 0; k < 3; k++)
+      {
+        if (band->dither == QUANTIZE_DITHER_FLOYD_STEINBERG)
+        {
+          cur[3 * (x + 1) + k]    += 7 * error[k];
+          next[3 * (x - 1) + k]   += 3 * error[k];
+          next[3 * x + k]         += 5 * error[k];
+          next[3 * (x + 1) + k]   += 1 * error[k];
+        }
+        else
+        {
+          /* atkinson passes on 6/8 of the error */
+          cur[3 * (x + 1) + k]    += 2 * error[k];
+          cur[3 * (x + 2) + k]    += 2 * error[k];
+          next[3 * (x - 1) + k]   += 2 * error[k];
+          next[3 * x + k]         += 2 * error[k];
+          next[3 * (x + 1) + k]   += 2 * error[k];
+          next_2[3 * x + k]       += 2 * error[k];
+        }
+      }
+    }
+
+    /* move on to the next row (the old row is reused at the bottom) */
+    e = band->error_rows[0];
+
+    band->error_rows[0] = band->error_rows[1];
+    band->error_rows[1] = band->error_rows[2];
+    band->error_rows[2] = e;
+
+    memset(e, 0, sizeof(int) * 3 * (band->width + 2 * QUANTIZE_ERROR_PADDING));
+  }
+}
+
+/*******************************************************************************
+** quantize_image()
+*******************************************************************************/
+short int quantize_image( palette_context* pc, nearest_index* ni,
+                          char* input_filename, char* output_filename,
+                          int dither, quantize_stats* stats)
+{
+  image_reader  ir;
+  image_writer  iw;
+
+  quantize_band band;
+
+  int     band_rows;
+  int     num_rows;
+  int     row;
+  int     k;
+
+  double  start;
+
+  start = timer_seconds();
+
+  /* open input image */
+  if (image_reader_open(&ir, input_filename))
+    return 1;
+
+  /* open output image */
+  if (image_writer_open_indexed(&iw, output_filename,
+                                ir.width, ir.height, ir.top_down,
+                                pc->colors_array, pc->num_colors))
+  {
+    image_reader_close(&ir);
+    return 1;
+  }
+
+  /* allocate band buffers */
+  band_rows = QUANTIZE_BAND_PIXELS / ir.width;
+
+  if (band_rows < 1)
+    band_rows = 1;
+  else if (band_rows > ir.height)
+    band_rows = ir.height;
+
+  band.ni = ni;
+  band.palette = pc->colors_array;
+  band.width = ir.width;
+  band.first_row = 0;
+  band.dither = dither;
+
+  /* the ordered dither spread is about the spacing between */
+  /* palette colors, if they were spread evenly in the cube */
+  band.spread = (int) (256.0 / pow(pc->num_colors, 1.0 / 3.0));
+
+  band.pixels = malloc(sizeof(color) * ir.width * band_rows);
+  band.indices = malloc(sizeof(int) * ir.width * band_rows);
+
+  /* error diffusion only needs a few rows of error, */
+  /* no matter how tall the image is                 */
+  for (k = 0; k < QUANTIZE_ERROR_ROWS; k++)
+  {
+    band.error_rows[k] = calloc(3 * (ir.width + 2 * QUANTIZE_ERROR_PADDING),
+                                sizeof(int));
+  }
+
+  if ((band.pixels == NULL)         ||
+      (band.indices == NULL)        ||
+      (band.error_rows[0] == NULL)  ||
+      (band.error_rows[1] == NULL)  ||
+      (band.error_rows[2] == NULL))
+  {
+    printf("Quantize image failed: Out of memory.\n");
+
+    free(band.pixels);
+    free(band.indices);
+
+    for (k = 0; k < QUANTIZE_ERROR_ROWS; k++)
+      free(band.error_rows[k]);
+
+    image_reader_close(&ir);
+    image_writer_close(&iw);
+    return 1;
+  }
+
+  /* read a band, map its rows across threads, and write it out */
+  for (row = 0; row < ir.height; row += num_rows)
+  {
+    num_rows = band_rows;
+
+    if (row + num_rows > ir.height)
+      num_rows = ir.height - row;
+
+    if (image_read_rows(&ir, band.pixels, num_rows))
+      break;
+
+    band.first_row = row;
+
+    /* error diffusion goes row by row, and the */
+    /* other modes are split across threads     */
+    if ((dither == QUANTIZE_DITHER_FLOYD_STEINBERG) ||
+        (dither == QUANTIZE_DITHER_ATKINSON))
+    {
+      quantize_rows_diffused(&band, num_rows);
+    }
+    else if (dither == QUANTIZE_DITHER_BAYER)
+    {
+      if (parallel_run(num_rows, quantize_row_ordered, &band))
+        break;
+    }
+    else
+    {
+      if (parallel_run(num_rows, quantize_row, &band))
+        break;
+    }
+
+    if (image_write_index_rows(&iw, band.indices, num_rows))
+      break;
+  }
+
+  free(band.pixels);
+  free(band.indices);
+
+  for (k = 0; k < QUANTIZE_ERROR_ROWS; k++)
+    free(band.error_rows[k]);
+
+  image_reader_close(&ir);
+
+  if (image_writer_close(&iw) || (row < ir.height))
+  {
+    printf("Quantize image failed: Unable to finish output image.\n");
+    return 1;
+  }
+
+  /* fill in stats */
+  if (stats != NULL)
+  {
+    stats->width = ir.width;
+    stats->height = ir.height;
+    stats->seconds = timer_seconds() - start;
+  }
+
+  return 0;
+}
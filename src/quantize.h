@@ -0,0 +1,37 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** quantize.h (image quantization)
+*******************************************************************************/
+
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+#include "nearest.h"
+#include "palette.h"
+
+enum
+{
+  QUANTIZE_DITHER_NONE = 0,
+  QUANTIZE_DITHER_FLOYD_STEINBERG,
+  QUANTIZE_DITHER_ATKINSON,
+  QUANTIZE_DITHER_BAYER
+};
+
+typedef struct quantize_stats
+{
+  int     width;
+  int     height;
+  double  seconds;
+} quantize_stats;
+
+/* function declarations */
+int       quantize_dither_from_name(char* name);
+
+short int quantize_image( palette_context* pc, nearest_index* ni,
+                          char* input_filename, char* output_filename,
+                          int dither, quantize_stats* stats);
+
+#endif
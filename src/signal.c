@@ -0,0 +1,418 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** signal.c (composite signal simulation)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "palette.h"
+#include "parallel.h"
+#include "signal.h"
+#include "yiq.h"
+
+/* each color is a square wave, at the low voltage for half of */
+/* each subcarrier cycle and the high voltage for the other    */
+/* half, with the hue setting where in the cycle the switch    */
+/* happens (the greys stay at the luma the whole time)         */
+
+/* the wave is sampled at a fixed rate, and then demodulated   */
+/* the way a tv does it: a low-pass filter gives the luma, and */
+/* mixing with the subcarrier before filtering gives i & q     */
+
+/* the demodulation is linear, so the y, i & q of each color   */
+/* are its luma times those of a constant signal, plus its     */
+/* saturation times those of a unit square wave with its hue;  */
+/* the sampled wave is only filtered once per hue, & the       */
+/* colors are then converted in vectorized columns             */
+
+/* palettes at least this large are generated on the worker pool, */
+/* with each job converting at least this many colors             */
+#define SIGNAL_PARALLEL_MIN_COLORS 65536
+#define SIGNAL_PARALLEL_JOB_COLORS 16384
+
+#define SIGNAL_SNAP_EPSILON 1.0e-12
+
+/* PI & TWO_PI are floats, which would keep the references */
+/* from cancelling out over whole cycles                   */
+#define SIGNAL_PI     3.14159265358979323846
+#define SIGNAL_TWO_PI 6.28318530717958647693
+
+typedef struct signal_jobs
+{
+  palette_context*  pc;
+
+  /* filter weights, times the luma, i & q references */
+  double*           luma_weights;
+  double*           i_weights;
+  double*           q_weights;
+  int               num_taps;
+
+  int               columns_per_job;
+
+  /* demodulated constant signal (the luma always comes out as is, */
+  /* but i & q pick up some of it unless the filter spans a whole  */
+  /* number of cycles)                                             */
+  double            dc_i;
+  double            dc_q;
+
+  /* per job y, i & q buffers & clamp counts */
+  float*            yiq_buffers;
+  int*              num_clamped;
+} signal_jobs;
+
+/* filter names (used for the command line) */
+static char* S_signal_filter_names[SIGNAL_NUM_FILTERS] =
+  { "box",
+    "hann"
+  };
+
+/*******************************************************************************
+** signal_filter_from_name()
+*******************************************************************************/
+int signal_filter_from_name(char* name)
+{
+  int k;
+
+  if (name == NULL)
+    return -1;
+
+  for (k = 0; k < SIGNAL_NUM_FILTERS; k++)
+  {
+    if (!strcmp(S_signal_filter_names[k], name))
+      return k;
+  }
+
+  return -1;
+}
+
+/*******************************************************************************
+** signal_filter_name()
+*******************************************************************************/
+char* signal_filter_name(int filter)
+{
+  if ((filter < 0) || (filter >= SIGNAL_NUM_FILTERS))
+    return NULL;
+
+  return S_signal_filter_names[filter];
+}
+
+/*******************************************************************************
+** signal_check_parameters()
+*******************************************************************************/
+short int signal_check_parameters(int rate, int filter, int taps)
+{
+  if ((rate < SIGNAL_MIN_RATE) || (rate > SIGNAL_MAX_RATE))
+  {
+    printf("Signal sample rate must be from %d to %d samples per cycle.\n",
+           SIGNAL_MIN_RATE, SIGNAL_MAX_RATE);
+    return 1;
+  }
+
+  if ((filter < 0) || (filter >= SIGNAL_NUM_FILTERS))
+  {
+    printf("Unknown signal filter.\n");
+    return 1;
+  }
+
+  if ((taps < 0) || (taps > SIGNAL_MAX_TAPS))
+  {
+    printf("Signal filter length must be from 1 to %d samples ",
+           SIGNAL_MAX_TAPS);
+    printf("(or 0 for the default length).\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** signal_num_taps()
+*******************************************************************************/
+int signal_num_taps(palette_context* pc)
+{
+  if (pc->signal_taps > 0)
+    return pc->signal_taps;
+
+  /* a whole number of cycles, so that the subcarrier cancels out */
+  if (pc->signal_filter == SIGNAL_FILTER_HANN)
+    return 2 * pc->signal_rate;
+
+  return pc->signal_rate;
+}
+
+/*******************************************************************************
+** signal_snap()
+*******************************************************************************/
+static double signal_snap(double value)
+{
+  /* sums that cancel out in theory are left with rounding noise, */
+  /* which is enough to tint the greys, so it is dropped          */
+  if (fabs(value) < SIGNAL_SNAP_EPSILON)
+    return 0.0;
+
+  return value;
+}
+
+/*******************************************************************************
+** signal_build_weights()
+*******************************************************************************/
+static void signal_build_weights(signal_jobs* jobs)
+{
+  palette_context* pc;
+
+  double w;
+  double sum;
+  double angle;
+
+  int t;
+
+  pc = jobs->pc;
+
+  /* filter window (centered on the samples) */
+  sum = 0.0;
+
+  for (t = 0; t < jobs->num_taps; t++)
+  {
+    if (pc->signal_filter == SIGNAL_FILTER_HANN)
+    {
+      w = sin(SIGNAL_PI * (t + 0.5) / jobs->num_taps);
+      w = w * w;
+    }
+    else
+      w = 1.0;
+
+    jobs->luma_weights[t] = w;
+    sum += w;
+  }
+
+  /* the references are a quarter cycle behind the wave, so */
+  /* that hue m comes out at the same angle as the phasors  */
+  /* of the composite sources (mixing halves the amplitude, */
+  /* so i & q are doubled)                                  */
+  for (t = 0; t < jobs->num_taps; t++)
+  {
+    angle = (SIGNAL_TWO_PI * (t + 0.5)) / pc->signal_rate;
+
+    w = jobs->luma_weights[t] / sum;
+
+    jobs->luma_weights[t] = w;
+    jobs->i_weights[t] = 2.0 * w * sin(angle);
+    jobs->q_weights[t] = -2.0 * w * cos(angle);
+  }
+
+  /* demodulated constant signal */
+  jobs->dc_i = 0.0;
+  jobs->dc_q = 0.0;
+
+  for (t = 0; t < jobs->num_taps; t++)
+  {
+    jobs->dc_i += jobs->i_weights[t];
+    jobs->dc_q += jobs->q_weights[t];
+  }
+
+  jobs->dc_i = signal_snap(jobs->dc_i);
+  jobs->dc_q = signal_snap(jobs->dc_q);
+}
+
+/*******************************************************************************
+** signal_demodulate_hue()
+*******************************************************************************/
+static void signal_demodulate_hue(signal_jobs* jobs, int hue,
+                                  double* y, double* i, double* q)
+{
+  double s;
+
+  long period;
+  long phase;
+  long step;
+
+  int t;
+
+  /* sample t (at time t + 1/2) is at the high voltage when it */
+  /* is in the first half of the cycle that starts at the hue; */
+  /* the phase is kept as an integer (in 1 / 2rh of a cycle)   */
+  /* so that samples right on a switch always go the same way  */
+  period = 2L * jobs->pc->signal_rate * jobs->pc->num_hues;
+  step = 2L * jobs->pc->num_hues;
+
+  phase = jobs->pc->num_hues - (2L * hue * jobs->pc->signal_rate) % period;
+
+  if (phase < 0)
+    phase += period;
+
+  *y = 0.0;
+  *i = 0.0;
+  *q = 0.0;
+
+  for (t = 0; t < jobs->num_taps; t++)
+  {
+    s = (phase < period / 2) ? 1.0 : -1.0;
+
+    *y += s * jobs->luma_weights[t];
+    *i += s * jobs->i_weights[t];
+    *q += s * jobs->q_weights[t];
+
+    phase += step;
+
+    if (phase >= period)
+      phase -= period;
+  }
+
+  *y = signal_snap(*y);
+  *i = signal_snap(*i);
+  *q = signal_snap(*q);
+}
+
+/*******************************************************************************
+** generate_signal_columns()
+*******************************************************************************/
+static void generate_signal_columns(void* data, int index)
+{
+  signal_jobs*      jobs;
+  palette_context*  pc;
+
+  float*  y_column;
+  float*  i_column;
+  float*  q_column;
+
+  double  y;
+  double  i;
+  double  q;
+
+  int     column;
+  int     end;
+  int     k;
+
+  jobs = (signal_jobs*) data;
+  pc = jobs->pc;
+
+  column = index * jobs->columns_per_job;
+  end = column + jobs->columns_per_job;
+
+  if (end > pc->num_hues + 1)
+    end = pc->num_hues + 1;
+
+  y_column = &jobs->yiq_buffers[3L * index * pc->table_length];
+  i_column = y_column + pc->table_length;
+  q_column = i_column + pc->table_length;
+
+  jobs->num_clamped[index] = 0;
+
+  for (; column < end; column++)
+  {
+    /* column 0 is the greys, and column m + 1 is hue m */
+    if (column == 0)
+    {
+      y = 0.0;
+      i = 0.0;
+      q = 0.0;
+    }
+    else
+      signal_demodulate_hue(jobs, column - 1, &y, &i, &q);
+
+    for (k = 0; k < pc->table_length; k++)
+    {
+      y_column[k] = (float) (pc->luma_table[k] + pc->saturation_table[k] * y);
+      i_column[k] = (float) ( pc->luma_table[k] * jobs->dc_i +
+                              pc->saturation_table[k] * i);
+      q_column[k] = (float) ( pc->luma_table[k] * jobs->dc_q +
+                              pc->saturation_table[k] * q);
+    }
+
+    jobs->num_clamped[index] +=
+      yiq_convert_colors( y_column, i_column, q_column, pc->table_length,
+                          &pc->colors_array[pc->num_colors +
+                                            column * pc->table_length]);
+  }
+}
+
+/*******************************************************************************
+** generate_palette_signal()
+*******************************************************************************/
+short int generate_palette_signal(palette_context* pc)
+{
+  signal_jobs jobs;
+
+  int num_colors;
+  int num_jobs;
+  int k;
+
+  if (signal_check_parameters(pc->signal_rate, pc->signal_filter,
+                              pc->signal_taps))
+  {
+    return 1;
+  }
+
+  /* there is one column of greys, and one column per hue */
+  num_colors = pc->table_length * (pc->num_hues + 1);
+
+  if (pc->num_colors + num_colors > pc->max_colors)
+  {
+    printf("Unable to add colors: Colors array is filled.\n");
+    return 1;
+  }
+
+  jobs.pc = pc;
+  jobs.num_taps = signal_num_taps(pc);
+  jobs.columns_per_job = SIGNAL_PARALLEL_JOB_COLORS / pc->table_length + 1;
+
+  num_jobs = (pc->num_hues + jobs.columns_per_job) / jobs.columns_per_job;
+
+  jobs.luma_weights = malloc(sizeof(double) * jobs.num_taps);
+  jobs.i_weights = malloc(sizeof(double) * jobs.num_taps);
+  jobs.q_weights = malloc(sizeof(double) * jobs.num_taps);
+
+  jobs.yiq_buffers = malloc(sizeof(float) * 3 * num_jobs * pc->table_length);
+  jobs.num_clamped = malloc(sizeof(int) * num_jobs);
+
+  if ((jobs.luma_weights == NULL) ||
+      (jobs.i_weights == NULL)    ||
+      (jobs.q_weights == NULL)    ||
+      (jobs.yiq_buffers == NULL)  ||
+      (jobs.num_clamped == NULL))
+  {
+    printf("Unable to add colors: Out of memory.\n");
+    free(jobs.luma_weights);
+    free(jobs.i_weights);
+    free(jobs.q_weights);
+    free(jobs.yiq_buffers);
+    free(jobs.num_clamped);
+    return 1;
+  }
+
+  signal_build_weights(&jobs);
+
+  /* demodulate greys & hues (large palettes are split across threads) */
+  if (num_colors >= SIGNAL_PARALLEL_MIN_COLORS)
+  {
+    if (parallel_run(num_jobs, generate_signal_columns, &jobs))
+      num_jobs = 0;
+  }
+  else
+  {
+    for (k = 0; k < num_jobs; k++)
+      generate_signal_columns(&jobs, k);
+  }
+
+  for (k = 0; k < num_jobs; k++)
+    pc->num_clamped += jobs.num_clamped[k];
+
+  free(jobs.luma_weights);
+  free(jobs.i_weights);
+  free(jobs.q_weights);
+  free(jobs.yiq_buffers);
+  free(jobs.num_clamped);
+
+  if (num_jobs == 0)
+    return 1;
+
+  pc->num_colors += num_colors;
+
+  return 0;
+}
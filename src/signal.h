@@ -0,0 +1,40 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** signal.h (composite signal simulation)
+*******************************************************************************/
+
+#ifndef SIGNAL_H
+#define SIGNAL_H
+
+#include "palette.h"
+
+/* demodulation filters */
+enum
+{
+  SIGNAL_FILTER_BOX = 0,
+  SIGNAL_FILTER_HANN,
+  SIGNAL_NUM_FILTERS
+};
+
+/* samples per color subcarrier cycle (the nes ppu uses 12) */
+#define SIGNAL_DEFAULT_RATE 12
+#define SIGNAL_MIN_RATE     2
+#define SIGNAL_MAX_RATE     256
+
+/* filter length in samples (0 picks one cycle for the box */
+/* filter, and two cycles for the hann filter)              */
+#define SIGNAL_MAX_TAPS     4096
+
+/* function declarations */
+int       signal_filter_from_name(char* name);
+char*     signal_filter_name(int filter);
+
+short int signal_check_parameters(int rate, int filter, int taps);
+int       signal_num_taps(palette_context* pc);
+
+short int generate_palette_signal(palette_context* pc);
+
+#endif
@@ -0,0 +1,116 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** timer.c (wall clock timing & memory usage)
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TIMER_HAVE_RUSAGE
+#include <sys/resource.h>
+#endif
+
+/* linux can reset the peak resident set size, */
+/* and reports it (as VmHWM) in /proc          */
+#if defined(__linux__)
+#define TIMER_HAVE_PROC
+#endif
+
+#include "timer.h"
+
+/*******************************************************************************
+** timer_seconds()
+*******************************************************************************/
+double timer_seconds(void)
+{
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts))
+    return 0.0;
+
+  return ts.tv_sec + (ts.tv_nsec * 1.0e-9);
+}
+
+/*******************************************************************************
+** timer_reset_peak_memory()
+*******************************************************************************/
+short int timer_reset_peak_memory(void)
+{
+#if defined(TIMER_HAVE_PROC)
+  FILE* fp;
+
+  fp = fopen("/proc/self/clear_refs", "w");
+
+  if (fp == NULL)
+    return 1;
+
+  /* 5 resets the peak to the current resident set size */
+  if (fputs("5", fp) == EOF)
+  {
+    fclose(fp);
+    return 1;
+  }
+
+  if (fclose(fp))
+    return 1;
+
+  return 0;
+#else
+  return 1;
+#endif
+}
+
+/*******************************************************************************
+** timer_peak_memory_kb()
+*******************************************************************************/
+long timer_peak_memory_kb(void)
+{
+#if defined(TIMER_HAVE_PROC)
+  FILE* fp;
+  char  line[256];
+  long  peak;
+
+  /* the peak since the last reset */
+  fp = fopen("/proc/self/status", "r");
+
+  if (fp != NULL)
+  {
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+      if (sscanf(line, "VmHWM: %ld", &peak) == 1)
+      {
+        fclose(fp);
+        return peak;
+      }
+    }
+
+    fclose(fp);
+  }
+#endif
+
+#if defined(TIMER_HAVE_RUSAGE)
+  {
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru))
+      return 0;
+
+    /* the peak resident set size is for the whole process */
+    /* (it is in kilobytes on linux, and bytes on macos)    */
+#if defined(__APPLE__)
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+  }
+#else
+  return 0;
+#endif
+}
@@ -0,0 +1,20 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** timer.h (wall clock timing & memory usage)
+*******************************************************************************/
+
+#ifndef TIMER_H
+#define TIMER_H
+
+/* function declarations */
+double    timer_seconds(void);
+
+/* the peak is for the whole process, and only covers the  */
+/* time since the last reset where it can be reset (linux) */
+short int timer_reset_peak_memory(void);
+long      timer_peak_memory_kb(void);
+
+#endif
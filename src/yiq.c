@@ -0,0 +1,502 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** yiq.c (yiq to rgb conversion)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define YIQ_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(YIQ_HAVE_SSE2) && defined(__x86_64__)
+#define YIQ_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+#include "palette.h"
+#include "yiq.h"
+
+/* -1 means the fastest kernel for the processor is used */
+/* (this is only written by yiq_set_kernel(), so that     */
+/* conversions running on several threads never write it) */
+static int S_kernel = -1;
+
+/*******************************************************************************
+** yiq_kernel()
+*******************************************************************************/
+int yiq_kernel(void)
+{
+  if (S_kernel >= 0)
+    return S_kernel;
+
+  /* select the fastest kernel supported by this processor */
+  /* (the cpu features are read when the program starts)   */
+#if defined(YIQ_HAVE_AVX2)
+  if (__builtin_cpu_supports("avx2"))
+    return YIQ_KERNEL_AVX2;
+  else
+    return YIQ_KERNEL_SSE2;
+#elif defined(YIQ_HAVE_SSE2)
+  return YIQ_KERNEL_SSE2;
+#else
+  return YIQ_KERNEL_SCALAR;
+#endif
+}
+
+/*******************************************************************************
+** yiq_set_kernel()
+*******************************************************************************/
+void yiq_set_kernel(int kernel)
+{
+  /* go back to automatic selection if this kernel is unavailable */
+  S_kernel = -1;
+
+  if (kernel == YIQ_KERNEL_SCALAR)
+    S_kernel = YIQ_KERNEL_SCALAR;
+#if defined(YIQ_HAVE_SSE2)
+  else if (kernel == YIQ_KERNEL_SSE2)
+    S_kernel = YIQ_KERNEL_SSE2;
+#endif
+#if defined(YIQ_HAVE_AVX2)
+  else if ((kernel == YIQ_KERNEL_AVX2) && (yiq_kernel() == YIQ_KERNEL_AVX2))
+    S_kernel = YIQ_KERNEL_AVX2;
+#endif
+}
+
+/*******************************************************************************
+** yiq_pack_scalar()
+*******************************************************************************/
+static int yiq_pack_scalar(float y, float i, float q, color* output)
+{
+  int r;
+  int g;
+  int b;
+
+  int clamped;
+
+  r = (int) (((y + (i * 0.956f) + (q * 0.619f)) * 255) + 0.5f);
+  g = (int) (((y - (i * 0.272f) - (q * 0.647f)) * 255) + 0.5f);
+  b = (int) (((y - (i * 1.106f) + (q * 1.703f)) * 255) + 0.5f);
+
+  /* count colors that are outside of the rgb cube */
+  clamped = 0;
+
+  if ((r < 0) || (r > 255) || (g < 0) || (g > 255) || (b < 0) || (b > 255))
+    clamped = 1;
+
+  /* bound rgb values */
+  if (r < 0)
+    r = 0;
+  else if (r > 255)
+    r = 255;
+
+  if (g < 0)
+    g = 0;
+  else if (g > 255)
+    g = 255;
+
+  if (b < 0)
+    b = 0;
+  else if (b > 255)
+    b = 255;
+
+  output->r = r;
+  output->g = g;
+  output->b = b;
+
+  return clamped;
+}
+
+/*******************************************************************************
+** yiq_convert_column_scalar()
+*******************************************************************************/
+int yiq_convert_column_scalar(float* luma, float* saturation, int length,
+                              double cos_hue, double sin_hue, color* output)
+{
+  int   k;
+  int   num_clamped;
+
+  num_clamped = 0;
+
+  for (k = 0; k < length; k++)
+  {
+    num_clamped += yiq_pack_scalar( luma[k],
+                                    (float) (saturation[k] * cos_hue),
+                                    (float) (saturation[k] * sin_hue),
+                                    &output[k]);
+  }
+
+  return num_clamped;
+}
+
+/*******************************************************************************
+** yiq_convert_colors_scalar()
+*******************************************************************************/
+int yiq_convert_colors_scalar(float* y, float* i, float* q, int length,
+                              color* output)
+{
+  int   k;
+  int   num_clamped;
+
+  num_clamped = 0;
+
+  for (k = 0; k < length; k++)
+    num_clamped += yiq_pack_scalar(y[k], i[k], q[k], &output[k]);
+
+  return num_clamped;
+}
+
+#if defined(YIQ_HAVE_SSE2)
+/*******************************************************************************
+** yiq_pack_sse2()
+*******************************************************************************/
+static int yiq_pack_sse2(__m128 y_4, __m128 i_4, __m128 q_4, color* output)
+{
+  int     n;
+
+  __m128  r_4;
+  __m128  g_4;
+  __m128  b_4;
+
+  __m128i r_4i;
+  __m128i g_4i;
+  __m128i b_4i;
+  __m128i out_4;
+  __m128i rgb;
+
+  unsigned char lanes[16];
+
+  r_4 = _mm_add_ps( _mm_add_ps(y_4, _mm_mul_ps(i_4, _mm_set1_ps(0.956f))),
+                    _mm_mul_ps(q_4, _mm_set1_ps(0.619f)));
+  g_4 = _mm_sub_ps( _mm_sub_ps(y_4, _mm_mul_ps(i_4, _mm_set1_ps(0.272f))),
+                    _mm_mul_ps(q_4, _mm_set1_ps(0.647f)));
+  b_4 = _mm_add_ps( _mm_sub_ps(y_4, _mm_mul_ps(i_4, _mm_set1_ps(1.106f))),
+                    _mm_mul_ps(q_4, _mm_set1_ps(1.703f)));
+
+  r_4 = _mm_add_ps(_mm_mul_ps(r_4, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f));
+  g_4 = _mm_add_ps(_mm_mul_ps(g_4, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f));
+  b_4 = _mm_add_ps(_mm_mul_ps(b_4, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f));
+
+  r_4i = _mm_cvttps_epi32(r_4);
+  g_4i = _mm_cvttps_epi32(g_4);
+  b_4i = _mm_cvttps_epi32(b_4);
+
+  /* count colors with any channel outside of 0-255 */
+  out_4 = _mm_or_si128(
+            _mm_or_si128( _mm_cmplt_epi32(r_4i, _mm_setzero_si128()),
+                          _mm_cmpgt_epi32(r_4i, _mm_set1_epi32(255))),
+            _mm_or_si128(
+              _mm_or_si128( _mm_cmplt_epi32(g_4i, _mm_setzero_si128()),
+                            _mm_cmpgt_epi32(g_4i, _mm_set1_epi32(255))),
+              _mm_or_si128( _mm_cmplt_epi32(b_4i, _mm_setzero_si128()),
+                            _mm_cmpgt_epi32(b_4i, _mm_set1_epi32(255)))));
+
+  /* bound to 0-255 with saturating packs */
+  rgb = _mm_packus_epi16( _mm_packs_epi32(r_4i, g_4i),
+                          _mm_packs_epi32(b_4i, _mm_setzero_si128()));
+
+  _mm_storeu_si128((__m128i*) lanes, rgb);
+
+  for (n = 0; n < 4; n++)
+  {
+    output[n].r = lanes[n];
+    output[n].g = lanes[n + 4];
+    output[n].b = lanes[n + 8];
+  }
+
+  return __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(out_4)));
+}
+
+/*******************************************************************************
+** yiq_convert_column_sse2()
+*******************************************************************************/
+static int yiq_convert_column_sse2(float* luma, float* saturation, int length,
+                                   double cos_hue, double sin_hue,
+                                   color* output)
+{
+  int     k;
+  int     num_clamped;
+
+  __m128d cos_2;
+  __m128d sin_2;
+
+  __m128  sat_4;
+  __m128  i_4;
+  __m128  q_4;
+
+  num_clamped = 0;
+
+  cos_2 = _mm_set1_pd(cos_hue);
+  sin_2 = _mm_set1_pd(sin_hue);
+
+  for (k = 0; k + 4 <= length; k += 4)
+  {
+    sat_4 = _mm_loadu_ps(&saturation[k]);
+
+    /* the products are formed in double precision and then rounded */
+    /* to float, so that they match the scalar path exactly          */
+    i_4 = _mm_movelh_ps(
+            _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(sat_4), cos_2)),
+            _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(sat_4, sat_4)),
+                                    cos_2)));
+
+    q_4 = _mm_movelh_ps(
+            _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(sat_4), sin_2)),
+            _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(sat_4, sat_4)),
+                                    sin_2)));
+
+    num_clamped += yiq_pack_sse2(_mm_loadu_ps(&luma[k]), i_4, q_4,
+                                 &output[k]);
+  }
+
+  /* convert remaining colors */
+  num_clamped += yiq_convert_column_scalar( &luma[k], &saturation[k],
+                                            length - k, cos_hue, sin_hue,
+                                            &output[k]);
+
+  return num_clamped;
+}
+
+/*******************************************************************************
+** yiq_convert_colors_sse2()
+*******************************************************************************/
+static int yiq_convert_colors_sse2(float* y, float* i, float* q, int length,
+                                   color* output)
+{
+  int k;
+  int num_clamped;
+
+  num_clamped = 0;
+
+  for (k = 0; k + 4 <= length; k += 4)
+  {
+    num_clamped += yiq_pack_sse2( _mm_loadu_ps(&y[k]),
+                                  _mm_loadu_ps(&i[k]),
+                                  _mm_loadu_ps(&q[k]),
+                                  &output[k]);
+  }
+
+  /* convert remaining colors */
+  num_clamped += yiq_convert_colors_scalar( &y[k], &i[k], &q[k], length - k,
+                                            &output[k]);
+
+  return num_clamped;
+}
+#endif
+
+#if defined(YIQ_HAVE_AVX2)
+/*******************************************************************************
+** yiq_pack_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static int yiq_pack_avx2(__m256 y_8, __m256 i_8, __m256 q_8, color* output)
+{
+  int     n;
+
+  __m256  r_8;
+  __m256  g_8;
+  __m256  b_8;
+
+  __m256i r_8i;
+  __m256i g_8i;
+  __m256i b_8i;
+  __m256i out_8;
+  __m256i rgb;
+
+  unsigned char lanes[32];
+
+  r_8 = _mm256_add_ps(
+          _mm256_add_ps(y_8, _mm256_mul_ps(i_8, _mm256_set1_ps(0.956f))),
+          _mm256_mul_ps(q_8, _mm256_set1_ps(0.619f)));
+  g_8 = _mm256_sub_ps(
+          _mm256_sub_ps(y_8, _mm256_mul_ps(i_8, _mm256_set1_ps(0.272f))),
+          _mm256_mul_ps(q_8, _mm256_set1_ps(0.647f)));
+  b_8 = _mm256_add_ps(
+          _mm256_sub_ps(y_8, _mm256_mul_ps(i_8, _mm256_set1_ps(1.106f))),
+          _mm256_mul_ps(q_8, _mm256_set1_ps(1.703f)));
+
+  r_8 = _mm256_add_ps(_mm256_mul_ps(r_8, _mm256_set1_ps(255.0f)),
+                      _mm256_set1_ps(0.5f));
+  g_8 = _mm256_add_ps(_mm256_mul_ps(g_8, _mm256_set1_ps(255.0f)),
+                      _mm256_set1_ps(0.5f));
+  b_8 = _mm256_add_ps(_mm256_mul_ps(b_8, _mm256_set1_ps(255.0f)),
+                      _mm256_set1_ps(0.5f));
+
+  r_8i = _mm256_cvttps_epi32(r_8);
+  g_8i = _mm256_cvttps_epi32(g_8);
+  b_8i = _mm256_cvttps_epi32(b_8);
+
+  /* count colors with any channel outside of 0-255 */
+  out_8 = _mm256_or_si256(
+            _mm256_or_si256(
+              _mm256_cmpgt_epi32(_mm256_setzero_si256(), r_8i),
+              _mm256_cmpgt_epi32(r_8i, _mm256_set1_epi32(255))),
+            _mm256_or_si256(
+              _mm256_or_si256(
+                _mm256_cmpgt_epi32(_mm256_setzero_si256(), g_8i),
+                _mm256_cmpgt_epi32(g_8i, _mm256_set1_epi32(255))),
+              _mm256_or_si256(
+                _mm256_cmpgt_epi32(_mm256_setzero_si256(), b_8i),
+                _mm256_cmpgt_epi32(b_8i, _mm256_set1_epi32(255)))));
+
+  /* bound to 0-255 with saturating packs (the packs work  */
+  /* within each 128-bit lane, so lane 0 holds colors 0-3 */
+  /* and lane 1 holds colors 4-7)                         */
+  rgb = _mm256_packus_epi16(_mm256_packs_epi32(r_8i, g_8i),
+                            _mm256_packs_epi32(b_8i, _mm256_setzero_si256()));
+
+  _mm256_storeu_si256((__m256i*) lanes, rgb);
+
+  for (n = 0; n < 4; n++)
+  {
+    output[n].r = lanes[n];
+    output[n].g = lanes[n + 4];
+    output[n].b = lanes[n + 8];
+
+    output[n + 4].r = lanes[n + 16];
+    output[n + 4].g = lanes[n + 20];
+    output[n + 4].b = lanes[n + 24];
+  }
+
+  return __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(out_8)));
+}
+
+/*******************************************************************************
+** yiq_convert_column_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static int yiq_convert_column_avx2(float* luma, float* saturation, int length,
+                                   double cos_hue, double sin_hue,
+                                   color* output)
+{
+  int     k;
+  int     num_clamped;
+
+  __m256d cos_4;
+  __m256d sin_4;
+
+  __m128  sat_lo;
+  __m128  sat_hi;
+
+  __m256  i_8;
+  __m256  q_8;
+
+  num_clamped = 0;
+
+  cos_4 = _mm256_set1_pd(cos_hue);
+  sin_4 = _mm256_set1_pd(sin_hue);
+
+  for (k = 0; k + 8 <= length; k += 8)
+  {
+    sat_lo = _mm_loadu_ps(&saturation[k]);
+    sat_hi = _mm_loadu_ps(&saturation[k + 4]);
+
+    /* the products are formed in double precision and then rounded */
+    /* to float, so that they match the scalar path exactly          */
+    i_8 = _mm256_insertf128_ps(
+            _mm256_castps128_ps256(
+              _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(sat_lo), cos_4))),
+            _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(sat_hi), cos_4)), 1);
+
+    q_8 = _mm256_insertf128_ps(
+            _mm256_castps128_ps256(
+              _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(sat_lo), sin_4))),
+            _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtps_pd(sat_hi), sin_4)), 1);
+
+    num_clamped += yiq_pack_avx2( _mm256_loadu_ps(&luma[k]), i_8, q_8,
+                                  &output[k]);
+  }
+
+  /* convert remaining colors */
+  num_clamped += yiq_convert_column_sse2( &luma[k], &saturation[k],
+                                          length - k, cos_hue, sin_hue,
+                                          &output[k]);
+
+  return num_clamped;
+}
+
+/*******************************************************************************
+** yiq_convert_colors_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static int yiq_convert_colors_avx2(float* y, float* i, float* q, int length,
+                                   color* output)
+{
+  int k;
+  int num_clamped;
+
+  num_clamped = 0;
+
+  for (k = 0; k + 8 <= length; k += 8)
+  {
+    num_clamped += yiq_pack_avx2( _mm256_loadu_ps(&y[k]),
+                                  _mm256_loadu_ps(&i[k]),
+                                  _mm256_loadu_ps(&q[k]),
+                                  &output[k]);
+  }
+
+  /* convert remaining colors */
+  num_clamped += yiq_convert_colors_sse2( &y[k], &i[k], &q[k], length - k,
+                                          &output[k]);
+
+  return num_clamped;
+}
+#endif
+
+/*******************************************************************************
+** yiq_convert_column()
+*******************************************************************************/
+int yiq_convert_column( float* luma, float* saturation, int length,
+                        double cos_hue, double sin_hue, color* output)
+{
+  int kernel;
+
+  kernel = yiq_kernel();
+
+#if defined(YIQ_HAVE_AVX2)
+  if (kernel == YIQ_KERNEL_AVX2)
+  {
+    return yiq_convert_column_avx2( luma, saturation, length,
+                                    cos_hue, sin_hue, output);
+  }
+#endif
+
+#if defined(YIQ_HAVE_SSE2)
+  if (kernel == YIQ_KERNEL_SSE2)
+  {
+    return yiq_convert_column_sse2( luma, saturation, length,
+                                    cos_hue, sin_hue, output);
+  }
+#endif
+
+  return yiq_convert_column_scalar( luma, saturation, length,
+                                    cos_hue, sin_hue, output);
+}
+
+/*******************************************************************************
+** yiq_convert_colors()
+*******************************************************************************/
+int yiq_convert_colors(float* y, float* i, float* q, int length, color* output)
+{
+  int kernel;
+
+  kernel = yiq_kernel();
+
+#if defined(YIQ_HAVE_AVX2)
+  if (kernel == YIQ_KERNEL_AVX2)
+    return yiq_convert_colors_avx2(y, i, q, length, output);
+#endif
+
+#if defined(YIQ_HAVE_SSE2)
+  if (kernel == YIQ_KERNEL_SSE2)
+    return yiq_convert_colors_sse2(y, i, q, length, output);
+#endif
+
+  return yiq_convert_colors_scalar(y, i, q, length, output);
+}
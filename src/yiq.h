@@ -0,0 +1,43 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** yiq.h (yiq to rgb conversion)
+*******************************************************************************/
+
+#ifndef YIQ_H
+#define YIQ_H
+
+#include "palette.h"
+
+enum
+{
+  YIQ_KERNEL_SCALAR = 0,
+  YIQ_KERNEL_SSE2,
+  YIQ_KERNEL_AVX2
+};
+
+/* function declarations */
+int   yiq_kernel(void);
+
+/* overrides the kernel for every conversion, so it is */
+/* set before any palettes are generated (not during)  */
+void  yiq_set_kernel(int kernel);
+
+/* the conversions return the number of colors that were */
+/* outside of the rgb cube (and had to be clamped)        */
+int   yiq_convert_column(float* luma, float* saturation, int length,
+                          double cos_hue, double sin_hue, color* output);
+
+int   yiq_convert_column_scalar(float* luma, float* saturation, int length,
+                                double cos_hue, double sin_hue, color* output);
+
+/* the same conversion, with the y, i & q of each color given directly */
+int   yiq_convert_colors(float* y, float* i, float* q, int length,
+                          color* output);
+
+int   yiq_convert_colors_scalar(float* y, float* i, float* q, int length,
+                                color* output);
+
+#endif
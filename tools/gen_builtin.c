@@ -0,0 +1,178 @@
+/*******************************************************************************
+** PALETTE (palette file generation) - Michael Behrens 2018-2023
+*******************************************************************************/
+
+/*******************************************************************************
+** gen_builtin.c (generates the built-in palette tables at build time)
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "palette.h"
+
+/*******************************************************************************
+** write_float_array()
+*******************************************************************************/
+static void write_float_array(FILE* fp, char* name, char* suffix,
+                              float* values, int length)
+{
+  int k;
+
+  fprintf(fp, "static const float S_%s_%s[%d] =\n  {", name, suffix, length);
+
+  /* 9 significant digits are enough to read back every float exactly */
+  for (k = 0; k < length; k++)
+  {
+    fprintf(fp, "%s", (k == 0) ? "" : ",");
+    fprintf(fp, "%s", (k % 4 == 0) ? "\n    " : " ");
+
+    fprintf(fp, "%.9ef", values[k]);
+  }
+
+  fprintf(fp, "\n  };\n\n");
+}
+
+/*******************************************************************************
+** write_double_array()
+*******************************************************************************/
+static void write_double_array( FILE* fp, char* name, char* suffix,
+                                double* values, int length)
+{
+  int k;
+
+  fprintf(fp, "static const double S_%s_%s[%d] =\n  {", name, suffix, length);
+
+  /* 17 significant digits are enough to read back every double exactly */
+  for (k = 0; k < length; k++)
+  {
+    fprintf(fp, "%s", (k == 0) ? "" : ",");
+    fprintf(fp, "%s", (k % 3 == 0) ? "\n    " : " ");
+
+    fprintf(fp, "%.17e", values[k]);
+  }
+
+  fprintf(fp, "\n  };\n\n");
+}
+
+/*******************************************************************************
+** write_color_array()
+*******************************************************************************/
+static void write_color_array(FILE* fp, char* name,
+                              color* colors, int num_colors)
+{
+  int k;
+
+  fprintf(fp, "static const color S_%s_colors[%d] =\n  {", name, num_colors);
+
+  for (k = 0; k < num_colors; k++)
+  {
+    fprintf(fp, "%s", (k == 0) ? "" : ",");
+    fprintf(fp, "%s", (k % 4 == 0) ? "\n    " : " ");
+
+    fprintf(fp, "{%3d, %3d, %3d}", colors[k].r, colors[k].g, colors[k].b);
+  }
+
+  fprintf(fp, "\n  };\n\n");
+}
+
+/*******************************************************************************
+** main()
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+  FILE* fp;
+
+  palette_context pc[SOURCE_NUM_SOURCES];
+
+  int source;
+
+  if (argc != 2)
+  {
+    fprintf(stderr, "Usage: gen_builtin output.c\n");
+    return 1;
+  }
+
+  /* generate the built-in palettes (at run time, as this */
+  /* program is built without the generated tables)       */
+  for (source = 0; source < SOURCE_NUM_SOURCES; source++)
+  {
+    if (palette_source_is_custom(source))
+      continue;
+
+    if (palette_init(&pc[source], source) || palette_generate(&pc[source]))
+    {
+      fprintf(stderr, "Unable to generate palette %s.\n",
+              palette_source_name(source));
+      return 1;
+    }
+  }
+
+  /* write the tables */
+  fp = fopen(argv[1], "w");
+
+  if (fp == NULL)
+  {
+    fprintf(stderr, "Unable to open %s for writing.\n", argv[1]);
+    return 1;
+  }
+
+  fprintf(fp, "/* generated by tools/gen_builtin.c - do not edit */\n\n");
+  fprintf(fp, "#include <stdio.h>\n\n");
+  fprintf(fp, "#include \"builtin.h\"\n");
+  fprintf(fp, "#include \"palette.h\"\n\n");
+
+  for (source = 0; source < SOURCE_NUM_SOURCES; source++)
+  {
+    if (palette_source_is_custom(source))
+      continue;
+
+    write_float_array(fp, pc[source].name, "luma",
+                      pc[source].luma_table, pc[source].table_length);
+    write_float_array(fp, pc[source].name, "saturation",
+                      pc[source].saturation_table, pc[source].table_length);
+    write_double_array( fp, pc[source].name, "cos",
+                        pc[source].cos_table, pc[source].num_hues);
+    write_double_array( fp, pc[source].name, "sin",
+                        pc[source].sin_table, pc[source].num_hues);
+    write_color_array(fp, pc[source].name,
+                      pc[source].colors_array, pc[source].num_colors);
+  }
+
+  fprintf(fp, "const palette_builtin palette_builtins[SOURCE_NUM_SOURCES] =\n");
+  fprintf(fp, "  {");
+
+  for (source = 0; source < SOURCE_NUM_SOURCES; source++)
+  {
+    if (palette_source_is_custom(source))
+      fprintf(fp, "\n    {0, 0, NULL, NULL, 0, NULL, NULL, 0, NULL}");
+    else
+    {
+      fprintf(fp, "\n    {%d, %d,\n", pc[source].num_colors,
+                                       pc[source].num_clamped);
+      fprintf(fp, "      S_%s_luma, S_%s_saturation, %d,\n",
+              pc[source].name, pc[source].name, pc[source].table_length);
+      fprintf(fp, "      S_%s_cos, S_%s_sin, %d,\n",
+              pc[source].name, pc[source].name, pc[source].num_hues);
+      fprintf(fp, "      S_%s_colors}", pc[source].name);
+    }
+
+    fprintf(fp, "%s", (source < SOURCE_NUM_SOURCES - 1) ? "," : "");
+  }
+
+  fprintf(fp, "\n  };\n");
+
+  for (source = 0; source < SOURCE_NUM_SOURCES; source++)
+  {
+    if (!palette_source_is_custom(source))
+      palette_deinit(&pc[source]);
+  }
+
+  if (fclose(fp))
+  {
+    fprintf(stderr, "Unable to finish writing %s.\n", argv[1]);
+    return 1;
+  }
+
+  return 0;
+}